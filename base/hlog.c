@@ -348,6 +348,21 @@ int logger_print(logger_t* logger, int level, const char* fmt, ...) {
     return len;
 }
 
+int logger_write(logger_t* logger, int level, const char* buf, int len) {
+    if (level < logger->level)
+        return -10;
+
+    hmutex_lock(&logger->mutex_);
+    if (logger->handler) {
+        logger->handler(level, buf, len);
+    }
+    else {
+        logfile_write(logger, buf, len);
+    }
+    hmutex_unlock(&logger->mutex_);
+    return len;
+}
+
 static logger_t* s_logger = NULL;
 logger_t* hv_default_logger() {
     if (s_logger == NULL) {
@@ -88,6 +88,8 @@ HV_EXPORT void logger_set_level_by_str(logger_t* logger, const char* level);
 HV_EXPORT void logger_set_max_bufsize(logger_t* logger, unsigned int bufsize);
 HV_EXPORT void logger_enable_color(logger_t* logger, int on);
 HV_EXPORT int  logger_print(logger_t* logger, int level, const char* fmt, ...);
+// write formatted lines as is, e.g. a batch of lines, with no prefix added
+HV_EXPORT int  logger_write(logger_t* logger, int level, const char* buf, int len);
 
 // below for file logger
 HV_EXPORT void logger_set_file(logger_t* logger, const char* filepath);
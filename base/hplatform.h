@@ -194,6 +194,8 @@
 #endif
 
 #ifdef _MSC_VER
+    #include <BaseTsd.h>
+    typedef SSIZE_T ssize_t;
     typedef int pid_t;
     typedef int gid_t;
     typedef int uid_t;
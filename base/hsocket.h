@@ -185,6 +185,24 @@ HV_INLINE int udp_broadcast(int sockfd, int on DEFAULT(1)) {
     return setsockopt(sockfd, SOL_SOCKET, SO_BROADCAST, (const char*)&on, sizeof(int));
 }
 
+HV_INLINE int so_reuseaddr(int sockfd, int on DEFAULT(1)) {
+#ifdef SO_REUSEADDR
+    return setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(int));
+#else
+    return -10;
+#endif
+}
+
+// NOTE: SO_REUSEPORT allow multiple sockets to bind same port,
+// and linux balances connections over the listening ones.
+HV_INLINE int so_reuseport(int sockfd, int on DEFAULT(1)) {
+#ifdef SO_REUSEPORT
+    return setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, (const char*)&on, sizeof(int));
+#else
+    return -10;
+#endif
+}
+
 // send timeout
 HV_INLINE int so_sndtimeo(int sockfd, int timeout) {
 #ifdef OS_WIN
@@ -60,8 +60,10 @@ set(EVPP_HEADERS
     evpp/EventLoop.h
     evpp/EventLoopThread.h
     evpp/EventLoopThreadPool.h
+    evpp/PubSub.h
     evpp/Status.h
     evpp/TcpClient.h
+    evpp/TcpProxy.h
     evpp/TcpServer.h
     evpp/UdpClient.h
     evpp/UdpServer.h
@@ -83,6 +85,7 @@ set(HTTP_HEADERS
     http/HttpMessage.h
     http/HttpParser.h
     http/WebSocketParser.h
+    http/WebSocketDeflate.h
     http/WebSocketChannel.h
 )
 
@@ -95,7 +98,10 @@ set(HTTP_CLIENT_HEADERS
 set(HTTP_SERVER_HEADERS
     http/server/HttpServer.h
     http/server/HttpService.h
+    http/server/HttpWorkerPool.h
     http/server/HttpContext.h
     http/server/HttpResponseWriter.h
+    http/server/HttpEventStream.h
     http/server/WebSocketServer.h
+    http/server/GrpcServer.h
 )
@@ -84,6 +84,11 @@ public:
         return 0;
     }
 
+    int taskNum() {
+        std::lock_guard<std::mutex> locker(_mutex);
+        return tasks.size();
+    }
+
     int wait() {
         while (1) {
             if (status == STOP || (tasks.empty() && idle_num == pool_size)) {
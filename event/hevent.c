@@ -47,38 +47,32 @@ static void hio_socket_init(hio_t* io) {
         nonblocking(io->fd);
     }
     // fill io->localaddr io->peeraddr
-    if (io->localaddr == NULL) {
-        HV_ALLOC(io->localaddr, sizeof(sockaddr_u));
-    }
-    if (io->peeraddr == NULL) {
-        HV_ALLOC(io->peeraddr, sizeof(sockaddr_u));
-    }
     socklen_t addrlen = sizeof(sockaddr_u);
-    int ret = getsockname(io->fd, io->localaddr, &addrlen);
+    int ret = getsockname(io->fd, &io->localaddr.sa, &addrlen);
     printd("getsockname fd=%d ret=%d errno=%d\n", io->fd, ret, socket_errno());
     // NOTE: udp peeraddr set by recvfrom/sendto
     if (io->io_type & HIO_TYPE_SOCK_STREAM) {
         addrlen = sizeof(sockaddr_u);
-        ret = getpeername(io->fd, io->peeraddr, &addrlen);
+        ret = getpeername(io->fd, &io->peeraddr.sa, &addrlen);
         printd("getpeername fd=%d ret=%d errno=%d\n", io->fd, ret, socket_errno());
     }
 }
 
 void hio_init(hio_t* io) {
-    // alloc localaddr,peeraddr when hio_socket_init
-    /*
-    if (io->localaddr == NULL) {
-        HV_ALLOC(io->localaddr, sizeof(sockaddr_u));
-    }
-    if (io->peeraddr == NULL) {
-        HV_ALLOC(io->peeraddr, sizeof(sockaddr_u));
-    }
-    */
-
     // write_queue init when hwrite try_write failed
     // write_queue_init(&io->write_queue, 4);
 
+    // alloc io->ext when hio_get_ext
+#ifndef ENABLE_LOCKFREE_WRITE
     hrecursive_mutex_init(&io->write_mutex);
+#endif
+}
+
+struct hio_ext_s* hio_get_ext(hio_t* io) {
+    if (io->ext == NULL) {
+        HV_ALLOC_SIZEOF(io->ext);
+    }
+    return io->ext;
 }
 
 void hio_ready(hio_t* io) {
@@ -112,23 +106,14 @@ void hio_ready(hio_t* io) {
     io->accept_cb = NULL;
     io->connect_cb = NULL;
     // timers
-    io->connect_timeout = 0;
-    io->connect_timer = NULL;
-    io->close_timeout = 0;
-    io->close_timer = NULL;
     io->keepalive_timeout = 0;
     io->keepalive_timer = NULL;
-    io->heartbeat_interval = 0;
-    io->heartbeat_fn = NULL;
-    io->heartbeat_timer = NULL;
-    // upstream
-    io->upstream_io = NULL;
-    // unpack
-    io->unpack_setting = NULL;
-    // ssl
-    io->ssl = NULL;
     // context
     io->ctx = NULL;
+    // timers, upstream, unpack, ssl, rudp
+    if (io->ext) {
+        memset(io->ext, 0, sizeof(struct hio_ext_s));
+    }
     // private:
 #if defined(EVENT_POLL) || defined(EVENT_KQUEUE)
     io->event_index[0] = io->event_index[1] = -1;
@@ -145,7 +130,7 @@ void hio_ready(hio_t* io) {
 
 #if WITH_RUDP
     if (io->io_type & HIO_TYPE_SOCK_RAW || io->io_type & HIO_TYPE_SOCK_DGRAM) {
-        rudp_init(&io->rudp);
+        rudp_init(&hio_get_ext(io)->rudp);
     }
 #endif
 }
@@ -161,18 +146,27 @@ void hio_done(hio_t* io) {
 
     // write_queue
     offset_buf_t* pbuf = NULL;
-    hrecursive_mutex_lock(&io->write_mutex);
+    hio_write_lock(io);
     while (!write_queue_empty(&io->write_queue)) {
         pbuf = write_queue_front(&io->write_queue);
         HV_FREE(pbuf->base);
         write_queue_pop_front(&io->write_queue);
     }
     write_queue_cleanup(&io->write_queue);
-    hrecursive_mutex_unlock(&io->write_mutex);
+    hio_write_unlock(io);
+
+#ifdef OS_LINUX
+    // splice
+    if (io->ext && io->ext->splice) {
+        close(io->ext->splice_pipe[0]);
+        close(io->ext->splice_pipe[1]);
+        io->ext->splice = 0;
+    }
+#endif
 
 #if WITH_RUDP
     if (io->io_type & HIO_TYPE_SOCK_RAW || io->io_type & HIO_TYPE_SOCK_DGRAM) {
-        rudp_cleanup(&io->rudp);
+        rudp_cleanup(&io->ext->rudp);
     }
 #endif
 }
@@ -180,9 +174,10 @@ void hio_done(hio_t* io) {
 void hio_free(hio_t* io) {
     if (io == NULL) return;
     hio_close(io);
+#ifndef ENABLE_LOCKFREE_WRITE
     hrecursive_mutex_destroy(&io->write_mutex);
-    HV_FREE(io->localaddr);
-    HV_FREE(io->peeraddr);
+#endif
+    HV_FREE(io->ext);
     HV_FREE(io);
 }
 
@@ -221,11 +216,11 @@ int hio_revents(hio_t* io) {
 }
 
 struct sockaddr* hio_localaddr(hio_t* io) {
-    return io->localaddr;
+    return &io->localaddr.sa;
 }
 
 struct sockaddr* hio_peeraddr(hio_t* io) {
-    return io->peeraddr;
+    return &io->peeraddr.sa;
 }
 
 void hio_set_context(hio_t* io, void* ctx) {
@@ -289,8 +284,8 @@ void hio_accept_cb(hio_t* io) {
     char localaddrstr[SOCKADDR_STRLEN] = {0};
     char peeraddrstr[SOCKADDR_STRLEN] = {0};
     printd("accept connfd=%d [%s] <= [%s]\n", io->fd,
-            SOCKADDR_STR(io->localaddr, localaddrstr),
-            SOCKADDR_STR(io->peeraddr, peeraddrstr));
+            SOCKADDR_STR(&io->localaddr, localaddrstr),
+            SOCKADDR_STR(&io->peeraddr, peeraddrstr));
     */
     if (io->accept_cb) {
         // printd("accept_cb------\n");
@@ -304,8 +299,8 @@ void hio_connect_cb(hio_t* io) {
     char localaddrstr[SOCKADDR_STRLEN] = {0};
     char peeraddrstr[SOCKADDR_STRLEN] = {0};
     printd("connect connfd=%d [%s] => [%s]\n", io->fd,
-            SOCKADDR_STR(io->localaddr, localaddrstr),
-            SOCKADDR_STR(io->peeraddr, peeraddrstr));
+            SOCKADDR_STR(&io->localaddr, localaddrstr),
+            SOCKADDR_STR(&io->peeraddr, peeraddrstr));
     */
     if (io->connect_cb) {
         // printd("connect_cb------\n");
@@ -353,17 +348,11 @@ void hio_set_type(hio_t* io, hio_type_e type) {
 }
 
 void hio_set_localaddr(hio_t* io, struct sockaddr* addr, int addrlen) {
-    if (io->localaddr == NULL) {
-        HV_ALLOC(io->localaddr, sizeof(sockaddr_u));
-    }
-    memcpy(io->localaddr, addr, addrlen);
+    memcpy(&io->localaddr, addr, addrlen);
 }
 
 void hio_set_peeraddr (hio_t* io, struct sockaddr* addr, int addrlen) {
-    if (io->peeraddr == NULL) {
-        HV_ALLOC(io->peeraddr, sizeof(sockaddr_u));
-    }
-    memcpy(io->peeraddr, addr, addrlen);
+    memcpy(&io->peeraddr, addr, addrlen);
 }
 
 int hio_enable_ssl(hio_t* io) {
@@ -376,12 +365,12 @@ bool hio_is_ssl(hio_t* io) {
 }
 
 hssl_t hio_get_ssl(hio_t* io) {
-    return io->ssl;
+    return io->ext ? io->ext->ssl : NULL;
 }
 
 int hio_set_ssl(hio_t* io, hssl_t ssl) {
     io->io_type = HIO_TYPE_SSL;
-    io->ssl = ssl;
+    hio_get_ext(io)->ssl = ssl;
     return 0;
 }
 
@@ -395,18 +384,20 @@ void hio_set_readbuf(hio_t* io, void* buf, size_t len) {
 }
 
 void hio_del_connect_timer(hio_t* io) {
-    if (io->connect_timer) {
-        htimer_del(io->connect_timer);
-        io->connect_timer = NULL;
-        io->connect_timeout = 0;
+    struct hio_ext_s* ext = io->ext;
+    if (ext && ext->connect_timer) {
+        htimer_del(ext->connect_timer);
+        ext->connect_timer = NULL;
+        ext->connect_timeout = 0;
     }
 }
 
 void hio_del_close_timer(hio_t* io) {
-    if (io->close_timer) {
-        htimer_del(io->close_timer);
-        io->close_timer = NULL;
-        io->close_timeout = 0;
+    struct hio_ext_s* ext = io->ext;
+    if (ext && ext->close_timer) {
+        htimer_del(ext->close_timer);
+        ext->close_timer = NULL;
+        ext->close_timeout = 0;
     }
 }
 
@@ -419,20 +410,21 @@ void hio_del_keepalive_timer(hio_t* io) {
 }
 
 void hio_del_heartbeat_timer(hio_t* io) {
-    if (io->heartbeat_timer) {
-        htimer_del(io->heartbeat_timer);
-        io->heartbeat_timer = NULL;
-        io->heartbeat_interval = 0;
-        io->heartbeat_fn = NULL;
+    struct hio_ext_s* ext = io->ext;
+    if (ext && ext->heartbeat_timer) {
+        htimer_del(ext->heartbeat_timer);
+        ext->heartbeat_timer = NULL;
+        ext->heartbeat_interval = 0;
+        ext->heartbeat_fn = NULL;
     }
 }
 
 void hio_set_connect_timeout(hio_t* io, int timeout_ms) {
-    io->connect_timeout = timeout_ms;
+    hio_get_ext(io)->connect_timeout = timeout_ms;
 }
 
 void hio_set_close_timeout(hio_t* io, int timeout_ms) {
-    io->close_timeout = timeout_ms;
+    hio_get_ext(io)->close_timeout = timeout_ms;
 }
 
 static void __keepalive_timeout_cb(htimer_t* timer) {
@@ -441,8 +433,8 @@ static void __keepalive_timeout_cb(htimer_t* timer) {
         char localaddrstr[SOCKADDR_STRLEN] = {0};
         char peeraddrstr[SOCKADDR_STRLEN] = {0};
         hlogw("keepalive timeout [%s] <=> [%s]",
-                SOCKADDR_STR(io->localaddr, localaddrstr),
-                SOCKADDR_STR(io->peeraddr, peeraddrstr));
+                SOCKADDR_STR(&io->localaddr, localaddrstr),
+                SOCKADDR_STR(&io->peeraddr, peeraddrstr));
         io->error = ETIMEDOUT;
         hio_close(io);
     }
@@ -469,8 +461,8 @@ void hio_set_keepalive_timeout(hio_t* io, int timeout_ms) {
 
 static void __heartbeat_timer_cb(htimer_t* timer) {
     hio_t* io = (hio_t*)timer->privdata;
-    if (io && io->heartbeat_fn) {
-        io->heartbeat_fn(io);
+    if (io && io->ext && io->ext->heartbeat_fn) {
+        io->ext->heartbeat_fn(io);
     }
 }
 
@@ -481,17 +473,38 @@ void hio_set_heartbeat(hio_t* io, int interval_ms, hio_send_heartbeat_fn fn) {
         return;
     }
 
-    if (io->heartbeat_timer) {
+    struct hio_ext_s* ext = hio_get_ext(io);
+    if (ext->heartbeat_timer) {
         // reset
-        ((struct htimeout_s*)io->heartbeat_timer)->timeout = interval_ms;
-        htimer_reset(io->heartbeat_timer);
+        ((struct htimeout_s*)ext->heartbeat_timer)->timeout = interval_ms;
+        htimer_reset(ext->heartbeat_timer);
     } else {
         // add
-        io->heartbeat_timer = htimer_add(io->loop, __heartbeat_timer_cb, interval_ms, INFINITE);
-        io->heartbeat_timer->privdata = io;
+        ext->heartbeat_timer = htimer_add(io->loop, __heartbeat_timer_cb, interval_ms, INFINITE);
+        ext->heartbeat_timer->privdata = io;
     }
-    io->heartbeat_interval = interval_ms;
-    io->heartbeat_fn = fn;
+    ext->heartbeat_interval = interval_ms;
+    ext->heartbeat_fn = fn;
+}
+
+void hio_set_write_watermark(hio_t* io, size_t high, size_t low,
+        hio_watermark_cb high_water_cb, hio_watermark_cb low_water_cb) {
+    struct hio_ext_s* ext = hio_get_ext(io);
+    hio_write_lock(io);
+    ext->write_high_water = high;
+    ext->write_low_water = low < high ? low : 0;
+    ext->write_high_water_cb = high_water_cb;
+    ext->write_low_water_cb = low_water_cb;
+    ext->over_write_high_water = 0;
+    hio_write_unlock(io);
+}
+
+int hio_is_over_write_high_water(hio_t* io) {
+    if (io->ext == NULL) return 0;
+    hio_write_lock(io);
+    int over = io->ext->over_write_high_water;
+    hio_write_unlock(io);
+    return over;
 }
 
 void hio_alloc_readbuf(hio_t* io, int len) {
@@ -534,28 +547,28 @@ void hio_set_unpack(hio_t* io, unpack_setting_t* setting) {
     hio_unset_unpack(io);
     if (setting == NULL) return;
 
-    io->unpack_setting = setting;
-    if (io->unpack_setting->package_max_length == 0) {
-        io->unpack_setting->package_max_length = DEFAULT_PACKAGE_MAX_LENGTH;
+    hio_get_ext(io)->unpack_setting = setting;
+    if (setting->package_max_length == 0) {
+        setting->package_max_length = DEFAULT_PACKAGE_MAX_LENGTH;
     }
-    if (io->unpack_setting->mode == UNPACK_BY_FIXED_LENGTH) {
-        assert(io->unpack_setting->fixed_length != 0 &&
-               io->unpack_setting->fixed_length <= io->unpack_setting->package_max_length);
+    if (setting->mode == UNPACK_BY_FIXED_LENGTH) {
+        assert(setting->fixed_length != 0 &&
+               setting->fixed_length <= setting->package_max_length);
     }
-    else if (io->unpack_setting->mode == UNPACK_BY_DELIMITER) {
-        if (io->unpack_setting->delimiter_bytes == 0) {
-            io->unpack_setting->delimiter_bytes = strlen((char*)io->unpack_setting->delimiter);
+    else if (setting->mode == UNPACK_BY_DELIMITER) {
+        if (setting->delimiter_bytes == 0) {
+            setting->delimiter_bytes = strlen((char*)setting->delimiter);
         }
     }
-    else if (io->unpack_setting->mode == UNPACK_BY_LENGTH_FIELD) {
-        assert(io->unpack_setting->body_offset >=
-               io->unpack_setting->length_field_offset +
-               io->unpack_setting->length_field_bytes);
+    else if (setting->mode == UNPACK_BY_LENGTH_FIELD) {
+        assert(setting->body_offset >=
+               setting->length_field_offset +
+               setting->length_field_bytes);
     }
 
     // NOTE: unpack must have own readbuf
-    if (io->unpack_setting->mode == UNPACK_BY_FIXED_LENGTH) {
-        io->readbuf.len = io->unpack_setting->fixed_length;
+    if (setting->mode == UNPACK_BY_FIXED_LENGTH) {
+        io->readbuf.len = setting->fixed_length;
     } else {
         io->readbuf.len = HLOOP_READ_BUFSIZE;
     }
@@ -563,8 +576,8 @@ void hio_set_unpack(hio_t* io, unpack_setting_t* setting) {
 }
 
 void hio_unset_unpack(hio_t* io) {
-    if (io->unpack_setting) {
-        io->unpack_setting = NULL;
+    if (io->ext && io->ext->unpack_setting) {
+        io->ext->unpack_setting = NULL;
         // NOTE: unpack has own readbuf
         hio_free_readbuf(io);
     }
@@ -572,7 +585,7 @@ void hio_unset_unpack(hio_t* io) {
 
 //-----------------upstream---------------------------------------------
 void hio_read_upstream(hio_t* io) {
-    hio_t* upstream_io = io->upstream_io;
+    hio_t* upstream_io = hio_get_upstream(io);
     if (upstream_io) {
         hio_read(io);
         hio_read(upstream_io);
@@ -580,28 +593,62 @@ void hio_read_upstream(hio_t* io) {
 }
 
 void hio_write_upstream(hio_t* io, void* buf, int bytes) {
-    hio_t* upstream_io = io->upstream_io;
+    hio_t* upstream_io = hio_get_upstream(io);
     if (upstream_io) {
         hio_write(upstream_io, buf, bytes);
     }
 }
 
 void hio_close_upstream(hio_t* io) {
-    hio_t* upstream_io = io->upstream_io;
+    hio_t* upstream_io = hio_get_upstream(io);
     if (upstream_io) {
         hio_close(upstream_io);
     }
 }
 
 void hio_setup_upstream(hio_t* io1, hio_t* io2) {
-    io1->upstream_io = io2;
-    io2->upstream_io = io1;
+    hio_get_ext(io1)->upstream_io = io2;
+    hio_get_ext(io2)->upstream_io = io1;
     hio_setcb_read(io1, hio_write_upstream);
     hio_setcb_read(io2, hio_write_upstream);
 }
 
 hio_t* hio_get_upstream(hio_t* io) {
-    return io->upstream_io;
+    return io->ext ? io->ext->upstream_io : NULL;
+}
+
+static void __upstream_high_water_cb(hio_t* io) {
+    hio_t* upstream_io = hio_get_upstream(io);
+    if (upstream_io) {
+        hio_read_stop(upstream_io);
+    }
+}
+
+static void __upstream_low_water_cb(hio_t* io) {
+    hio_t* upstream_io = hio_get_upstream(io);
+    if (upstream_io && !upstream_io->closed) {
+        hio_read_start(upstream_io);
+    }
+}
+
+void hio_set_upstream_backpressure(hio_t* io, size_t high, size_t low) {
+    hio_t* upstream_io = hio_get_upstream(io);
+    hio_set_write_watermark(io, high, low, __upstream_high_water_cb, __upstream_low_water_cb);
+    if (upstream_io) {
+        hio_set_write_watermark(upstream_io, high, low, __upstream_high_water_cb, __upstream_low_water_cb);
+    }
+}
+
+#ifndef OS_LINUX
+int hio_splice_upstream(hio_t* io) {
+    return -1;
+}
+#endif
+
+static void __tcp_upstream_connect_cb(hio_t* io) {
+    if (hio_splice_upstream(io) != 0) {
+        hio_read_upstream(io);
+    }
 }
 
 hio_t* hio_setup_tcp_upstream(hio_t* io, const char* host, int port, int ssl) {
@@ -609,9 +656,11 @@ hio_t* hio_setup_tcp_upstream(hio_t* io, const char* host, int port, int ssl) {
     if (upstream_io == NULL) return NULL;
     if (ssl) hio_enable_ssl(upstream_io);
     hio_setup_upstream(io, upstream_io);
+    // NOTE: a fast side must not flood the write queue of a slow side
+    hio_set_upstream_backpressure(io, UPSTREAM_WRITE_HIGH_WATER, UPSTREAM_WRITE_LOW_WATER);
     hio_setcb_close(io, hio_close_upstream);
     hio_setcb_close(upstream_io, hio_close_upstream);
-    hconnect(io->loop, upstream_io->fd, hio_read_upstream);
+    hconnect(io->loop, upstream_io->fd, __tcp_upstream_connect_cb);
     return upstream_io;
 }
 
@@ -625,23 +674,23 @@ hio_t* hio_setup_udp_upstream(hio_t* io, const char* host, int port) {
 
 #if WITH_RUDP
 rudp_entry_t* hio_get_rudp(hio_t* io) {
-    rudp_entry_t* rudp = rudp_get(&io->rudp, io->peeraddr);
+    rudp_entry_t* rudp = rudp_get(&io->ext->rudp, &io->peeraddr.sa);
     rudp->io = io;
     return rudp;
 }
 
 static void hio_close_rudp_event_cb(hevent_t* ev) {
     rudp_entry_t* entry = (rudp_entry_t*)ev->userdata;
-    rudp_del(&entry->io->rudp, (struct sockaddr*)&entry->addr);
+    rudp_del(&entry->io->ext->rudp, (struct sockaddr*)&entry->addr);
     // rudp_entry_free(entry);
 }
 
 int hio_close_rudp(hio_t* io, struct sockaddr* peeraddr) {
-    if (peeraddr == NULL) peeraddr = io->peeraddr;
+    if (peeraddr == NULL) peeraddr = &io->peeraddr.sa;
     // NOTE: do rudp_del for thread-safe
-    rudp_entry_t* entry = rudp_get(&io->rudp, peeraddr);
+    rudp_entry_t* entry = rudp_get(&io->ext->rudp, peeraddr);
     // NOTE: just rudp_remove first, do rudp_entry_free async for safe.
-    // rudp_entry_t* entry = rudp_remove(&io->rudp, peeraddr);
+    // rudp_entry_t* entry = rudp_remove(&io->ext->rudp, peeraddr);
     if (entry) {
         hevent_t ev;
         memset(&ev, 0, sizeof(ev));
@@ -673,7 +722,7 @@ static void __kcp_update_timer_cb(htimer_t* timer) {
 
 int hio_set_kcp(hio_t* io, kcp_setting_t* setting) {
     io->io_type = HIO_TYPE_KCP;
-    io->kcp_setting = setting;
+    hio_get_ext(io)->kcp_setting = setting;
     return 0;
 }
 
@@ -682,11 +731,11 @@ kcp_t* hio_get_kcp(hio_t* io, uint32_t conv) {
     assert(rudp != NULL);
     kcp_t* kcp = &rudp->kcp;
     if (kcp->ikcp != NULL) return kcp;
-    if (io->kcp_setting == NULL) {
-        io->kcp_setting = &s_kcp_setting;
+    if (io->ext->kcp_setting == NULL) {
+        io->ext->kcp_setting = &s_kcp_setting;
     }
-    kcp_setting_t* setting = io->kcp_setting;
-    assert(io->kcp_setting != NULL);
+    kcp_setting_t* setting = io->ext->kcp_setting;
+    assert(setting != NULL);
     kcp->ikcp = ikcp_create(conv, rudp);
     // printf("ikcp_create conv=%u ikcp=%p\n", conv, kcp->ikcp);
     kcp->ikcp->output = __kcp_output;
@@ -713,7 +762,7 @@ kcp_t* hio_get_kcp(hio_t* io, uint32_t conv) {
 }
 
 int hio_write_kcp(hio_t* io, const void* buf, size_t len) {
-    IUINT32 conv = io->kcp_setting ? io->kcp_setting->conv : 0;
+    IUINT32 conv = io->ext && io->ext->kcp_setting ? io->ext->kcp_setting->conv : 0;
     kcp_t* kcp = hio_get_kcp(io, conv);
     int nsend = ikcp_send(kcp->ikcp, (const char*)buf, len);
     // printf("ikcp_send len=%d nsend=%d\n", (int)len, nsend);
@@ -730,7 +779,7 @@ int hio_read_kcp (hio_t* io, void* buf, int readbytes) {
     kcp_t* kcp = hio_get_kcp(io, conv);
     if (kcp->conv != conv) {
         hloge("recv invalid kcp packet!");
-        hio_close_rudp(io, io->peeraddr);
+        hio_close_rudp(io, &io->peeraddr.sa);
         return -1;
     }
     // printf("ikcp_input len=%d\n", readbytes);
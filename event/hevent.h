@@ -4,6 +4,7 @@
 #include "hloop.h"
 #include "iowatcher.h"
 #include "rudp.h"
+#include "hsocket.h"
 
 #include "hbuf.h"
 #include "hmutex.h"
@@ -16,6 +17,10 @@
 #define HLOOP_READ_BUFSIZE          8192        // 8K
 #define READ_BUFSIZE_HIGH_WATER     65536       // 64K
 #define WRITE_QUEUE_HIGH_WATER      (1U << 23)  // 8M
+#define UPSTREAM_WRITE_HIGH_WATER   (1U << 20)  // 1M
+#define UPSTREAM_WRITE_LOW_WATER    (1U << 18)  // 256K
+#define HIO_WRITEV_MAX_BUFS         16
+#define HIO_SPLICE_PIPE_SIZE        65536       // 64K, default capacity of pipe
 
 ARRAY_DECL(hio_t*, io_array);
 QUEUE_DECL(hevent_t, event_queue);
@@ -27,6 +32,7 @@ struct hloop_s {
     uint64_t    start_hrtime;   // us
     uint64_t    end_hrtime;
     uint64_t    cur_hrtime;
+    uint64_t    busy_hrtime;    // us spent in callbacks
     uint64_t    loop_cnt;
     long        pid;
     long        tid;
@@ -90,7 +96,47 @@ struct hperiod_s {
 };
 
 QUEUE_DECL(offset_buf_t, write_queue);
-// sizeof(struct hio_s)=344 on linux-x64
+
+// rarely used state of hio, alloced by hio_get_ext on first use
+struct hio_ext_s {
+    // timers
+    int         connect_timeout;    // ms
+    int         close_timeout;      // ms
+    int         heartbeat_interval; // ms
+    hio_send_heartbeat_fn heartbeat_fn;
+    htimer_t*   connect_timer;
+    htimer_t*   close_timer;
+    htimer_t*   heartbeat_timer;
+    // write watermark, for hio_set_write_watermark
+    size_t      write_high_water;
+    size_t      write_low_water;
+    hio_watermark_cb    write_high_water_cb;
+    hio_watermark_cb    write_low_water_cb;
+    int         over_write_high_water;
+    // upstream
+    struct hio_s*       upstream_io;    // for hio_setup_upstream
+#ifdef OS_LINUX
+    // splice, for hio_splice_upstream
+    int         splice;
+    int         splice_eof;     // read EOF, passed on by shutdown write of upstream_io
+    int         splice_pipe[2];
+    size_t      splice_pipe_bytes;
+#endif
+    // unpack
+    unpack_setting_t*   unpack_setting; // for hio_set_unpack
+    // ssl
+    void*       ssl; // for hio_enable_ssl / hio_set_ssl
+#if WITH_RUDP
+    rudp_t          rudp;
+#if WITH_KCP
+    kcp_setting_t*  kcp_setting;
+#endif
+#endif
+};
+
+// NOTE: fields used by every read/write follow HEVENT_FIELDS,
+// see unittest/hio_sizeof_test.c
+// sizeof(struct hio_s)=320 on linux-x64
 struct hio_s {
     HEVENT_FIELDS
     // flags
@@ -107,44 +153,33 @@ struct hio_s {
     unsigned    read_once   :1;     // for hio_read_once
     unsigned    alloced_readbuf :1; // for hio_read_until, hio_set_unpack
 // public:
-    hio_type_e  io_type;
-    uint32_t    id; // fd cannot be used as unique identifier, so we provide an id
     int         fd;
-    int         error;
     int         events;
     int         revents;
-    struct sockaddr*    localaddr;
-    struct sockaddr*    peeraddr;
+    hio_type_e  io_type;
     offset_buf_t        readbuf;        // for read
     int                 read_until;     // for hio_read_until
     uint32_t            small_readbytes_cnt; // for readbuf autosize
+    hread_cb            read_cb;
+    hwrite_cb           write_cb;
     struct write_queue  write_queue;    // for write
-    hrecursive_mutex_t  write_mutex;    // lock write and write_queue
     uint32_t            write_queue_bytes;
+    int                 keepalive_timeout;  // ms
+    htimer_t*           keepalive_timer;
+    // context
+    void*       ctx; // for hio_context / hio_set_context
+    struct hio_ext_s*   ext;
+    uint32_t    id; // fd cannot be used as unique identifier, so we provide an id
+    int         error;
     // callbacks
-    hread_cb    read_cb;
-    hwrite_cb   write_cb;
     hclose_cb   close_cb;
     haccept_cb  accept_cb;
     hconnect_cb connect_cb;
-    // timers
-    int         connect_timeout;    // ms
-    int         close_timeout;      // ms
-    int         keepalive_timeout;  // ms
-    int         heartbeat_interval; // ms
-    hio_send_heartbeat_fn heartbeat_fn;
-    htimer_t*   connect_timer;
-    htimer_t*   close_timer;
-    htimer_t*   keepalive_timer;
-    htimer_t*   heartbeat_timer;
-    // upstream
-    struct hio_s*       upstream_io;    // for hio_setup_upstream
-    // unpack
-    unpack_setting_t*   unpack_setting; // for hio_set_unpack
-    // ssl
-    void*       ssl; // for hio_enable_ssl / hio_set_ssl
-    // context
-    void*       ctx; // for hio_context / hio_set_context
+    sockaddr_u  localaddr;
+    sockaddr_u  peeraddr;
+#ifndef ENABLE_LOCKFREE_WRITE
+    hrecursive_mutex_t  write_mutex;    // lock write and write_queue
+#endif
 // private:
 #if defined(EVENT_POLL) || defined(EVENT_KQUEUE)
     int         event_index[2]; // for poll,kqueue
@@ -153,14 +188,18 @@ struct hio_s {
 #ifdef EVENT_IOCP
     void*       hovlp;          // for iocp/overlapio
 #endif
+};
 
-#if WITH_RUDP
-    rudp_t          rudp;
-#if WITH_KCP
-    kcp_setting_t*  kcp_setting;
-#endif
+// NOTE: ENABLE_LOCKFREE_WRITE saves the mutex of each io,
+// but then hio_write/hio_writev must be called in the loop thread.
+#ifdef ENABLE_LOCKFREE_WRITE
+#define hio_write_lock(io)
+#define hio_write_unlock(io)
+#else
+#define hio_write_lock(io)      hrecursive_mutex_lock(&(io)->write_mutex)
+#define hio_write_unlock(io)    hrecursive_mutex_unlock(&(io)->write_mutex)
 #endif
-};
+
 /*
  * hio lifeline:
  *
@@ -178,6 +217,8 @@ void hio_done(hio_t* io);
 void hio_free(hio_t* io);
 uint32_t hio_next_id();
 
+struct hio_ext_s* hio_get_ext(hio_t* io);
+
 void hio_accept_cb(hio_t* io);
 void hio_connect_cb(hio_t* io);
 void hio_read_cb(hio_t* io, void* buf, int len);
@@ -131,6 +131,7 @@ static int hloop_process_events(hloop_t* loop) {
     // ios -> timers -> idles
     int nios, ntimers, nidles;
     nios = ntimers = nidles = 0;
+    uint64_t busy_begin;
 
     // calc blocktime
     int32_t blocktime = HLOOP_MAX_BLOCK_TIME;
@@ -156,6 +157,7 @@ static int hloop_process_events(hloop_t* loop) {
     }
 
 process_timers:
+    busy_begin = loop->cur_hrtime;
     if (loop->ntimers) {
         ntimers = hloop_process_timers(loop);
     }
@@ -167,6 +169,8 @@ process_timers:
         }
     }
     int ncbs = hloop_process_pendings(loop);
+    hloop_update_time(loop);
+    loop->busy_hrtime += loop->cur_hrtime - busy_begin;
     // printd("blocktime=%d nios=%d/%u ntimers=%d/%u nidles=%d/%u nactives=%d npendings=%d ncbs=%d\n",
     //         blocktime, nios, loop->nios, ntimers, loop->ntimers, nidles, loop->nidles,
     //         loop->nactives, npendings, ncbs);
@@ -459,6 +463,10 @@ uint64_t hloop_now(hloop_t* loop) {
     return loop->start_ms / 1000 + (loop->cur_hrtime - loop->start_hrtime) / 1000000;
 }
 
+uint64_t hloop_busy_hrtime(hloop_t* loop) {
+    return loop->busy_hrtime;
+}
+
 uint64_t hloop_now_ms(hloop_t* loop) {
     return loop->start_ms + (loop->cur_hrtime - loop->start_hrtime) / 1000;
 }
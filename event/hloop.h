@@ -4,6 +4,7 @@
 #include "hexport.h"
 #include "hplatform.h"
 #include "hdef.h"
+#include "hbuf.h"
 #include "hssl.h"
 
 typedef struct hloop_s      hloop_t;
@@ -144,6 +145,8 @@ HV_EXPORT uint64_t hloop_now(hloop_t* loop);          // s
 HV_EXPORT uint64_t hloop_now_ms(hloop_t* loop);       // ms
 HV_EXPORT uint64_t hloop_now_hrtime(hloop_t* loop);   // us
 #define hloop_now_us hloop_now_hrtime
+// @return us spent in callbacks since hloop_run, excluding blocking in poll
+HV_EXPORT uint64_t hloop_busy_hrtime(hloop_t* loop);
 // @return pid of hloop_run
 HV_EXPORT long hloop_pid(hloop_t* loop);
 // @return tid of hloop_run
@@ -299,6 +302,23 @@ typedef void (*hio_send_heartbeat_fn)(hio_t* io);
 // heartbeat interval => hio_send_heartbeat_fn
 HV_EXPORT void hio_set_heartbeat(hio_t* io, int interval_ms, hio_send_heartbeat_fn fn);
 
+/*
+void on_high_water(hio_t* io) {
+    hio_read_stop(peer_io);
+}
+void on_low_water(hio_t* io) {
+    hio_read_start(peer_io);
+}
+hio_set_write_watermark(io, 1 << 20, 1 << 18, on_high_water, on_low_water);
+*/
+typedef void (*hio_watermark_cb)(hio_t* io);
+// write queue bytes reach high => high_water_cb, then drained to low => low_water_cb
+// NOTE: high_water_cb is called in the thread calling hio_write, low_water_cb in loop thread.
+HV_EXPORT void hio_set_write_watermark(hio_t* io, size_t high, size_t low,
+        hio_watermark_cb high_water_cb, hio_watermark_cb low_water_cb DEFAULT(NULL));
+// @return 1 from high_water_cb until low_water_cb, else 0
+HV_EXPORT int  hio_is_over_write_high_water(hio_t* io);
+
 // Nonblocking, poll IO events in the loop to call corresponding callback.
 // hio_add(io, HV_READ) => accept => haccept_cb
 HV_EXPORT int hio_accept (hio_t* io);
@@ -313,7 +333,11 @@ HV_EXPORT int hio_read_once (hio_t* io);
 HV_EXPORT int hio_read_until(hio_t* io, int len);
 // NOTE: hio_write is thread-safe, locked by recursive_mutex, allow to be called by other threads.
 // hio_try_write => hio_add(io, HV_WRITE) => write => hwrite_cb
+// NOTE: hwrite_cb is called after the write queue updated, so it may write more in order.
 HV_EXPORT int hio_write  (hio_t* io, const void* buf, size_t len);
+// NOTE: hio_writev is thread-safe too, gather bufs into one writev for plain TCP,
+// otherwise merge bufs and hio_write. The unwritten remainder is copied into write_queue.
+HV_EXPORT int hio_writev (hio_t* io, const hbuf_t* bufs, int nbufs);
 // NOTE: hio_close is thread-safe, hio_close_async will be called actually in other thread.
 // hio_del(io, HV_RDWR) => close => hclose_cb
 HV_EXPORT int hio_close  (hio_t* io);
@@ -399,7 +423,18 @@ HV_EXPORT void   hio_setup_upstream(hio_t* io1, hio_t* io2);
 // @return io->upstream_io
 HV_EXPORT hio_t* hio_get_upstream(hio_t* io);
 
-// @tcp_upstream: hio_create -> hio_setup_upstream -> hio_setcb_close(hio_close_upstream) -> hconnect -> on_connect -> hio_read_upstream
+// backpressure: hio_read_stop(io->upstream_io) while write queue of io over high,
+// hio_read_start(io->upstream_io) when drained to low, and vice versa.
+// NOTE: overrides watermark callbacks of both io.
+HV_EXPORT void   hio_set_upstream_backpressure(hio_t* io, size_t high, size_t low);
+
+// zero-copy: splice(io => pipe => io->upstream_io), and vice versa, instead of hio_read_upstream.
+// NOTE: linux only, for plain TCP with read_cb hio_write_upstream.
+// NOTE: EOF of one side is passed on as half-close, closed on EOF of both or close_timeout.
+// @retval 0 if splicing, -1 if not supported, then use hio_read_upstream.
+HV_EXPORT int    hio_splice_upstream(hio_t* io);
+
+// @tcp_upstream: hio_create -> hio_setup_upstream -> hio_set_upstream_backpressure -> hio_setcb_close(hio_close_upstream) -> hconnect -> on_connect -> hio_splice_upstream or hio_read_upstream
 // @return upstream_io
 // @see examples/tcp_proxy_server
 HV_EXPORT hio_t* hio_setup_tcp_upstream(hio_t* io, const char* host, int port, int ssl DEFAULT(0));
@@ -7,14 +7,22 @@
 #include "hthread.h"
 #include "unpack.h"
 
+#ifdef OS_UNIX
+#include <sys/uio.h> // for writev
+#endif
+
+#ifdef OS_LINUX
+#include <fcntl.h> // for splice, pipe2
+#endif
+
 static void __connect_timeout_cb(htimer_t* timer) {
     hio_t* io = (hio_t*)timer->privdata;
     if (io) {
         char localaddrstr[SOCKADDR_STRLEN] = {0};
         char peeraddrstr[SOCKADDR_STRLEN] = {0};
         hlogw("connect timeout [%s] <=> [%s]",
-                SOCKADDR_STR(io->localaddr, localaddrstr),
-                SOCKADDR_STR(io->peeraddr, peeraddrstr));
+                SOCKADDR_STR(&io->localaddr, localaddrstr),
+                SOCKADDR_STR(&io->peeraddr, peeraddrstr));
         io->error = ETIMEDOUT;
         hio_close(io);
     }
@@ -26,8 +34,8 @@ static void __close_timeout_cb(htimer_t* timer) {
         char localaddrstr[SOCKADDR_STRLEN] = {0};
         char peeraddrstr[SOCKADDR_STRLEN] = {0};
         hlogw("close timeout [%s] <=> [%s]",
-                SOCKADDR_STR(io->localaddr, localaddrstr),
-                SOCKADDR_STR(io->peeraddr, peeraddrstr));
+                SOCKADDR_STR(&io->localaddr, localaddrstr),
+                SOCKADDR_STR(&io->peeraddr, peeraddrstr));
         io->error = ETIMEDOUT;
         hio_close(io);
     }
@@ -48,7 +56,7 @@ static void __read_cb(hio_t* io, void* buf, int readbytes) {
         htimer_reset(io->keepalive_timer);
     }
 
-    if (io->unpack_setting) {
+    if (io->ext && io->ext->unpack_setting) {
         hio_unpack(io, buf, readbytes);
     } else {
         if (io->read_once) {
@@ -81,6 +89,29 @@ static void __write_cb(hio_t* io, const void* buf, int writebytes) {
     hio_write_cb(io, buf, writebytes);
 }
 
+// NOTE: called with write lock held
+static void __write_high_water(hio_t* io) {
+    struct hio_ext_s* ext = io->ext;
+    if (ext == NULL || ext->write_high_water == 0 || ext->over_write_high_water) return;
+    if (io->write_queue_bytes >= ext->write_high_water) {
+        ext->over_write_high_water = 1;
+        if (ext->write_high_water_cb) {
+            ext->write_high_water_cb(io);
+        }
+    }
+}
+
+static void __write_low_water(hio_t* io) {
+    struct hio_ext_s* ext = io->ext;
+    if (ext == NULL || ext->over_write_high_water == 0) return;
+    if (io->write_queue_bytes <= ext->write_low_water) {
+        ext->over_write_high_water = 0;
+        if (ext->write_low_water_cb) {
+            ext->write_low_water_cb(io);
+        }
+    }
+}
+
 static void __close_cb(hio_t* io) {
     // printd("close fd=%d\n", io->fd);
     hio_del_connect_timer(io);
@@ -92,7 +123,7 @@ static void __close_cb(hio_t* io) {
 
 static void ssl_server_handshake(hio_t* io) {
     printd("ssl server handshake...\n");
-    int ret = hssl_accept(io->ssl);
+    int ret = hssl_accept(io->ext->ssl);
     if (ret == 0) {
         // handshake finish
         iowatcher_del_event(io->loop, io->fd, HV_READ);
@@ -114,7 +145,7 @@ static void ssl_server_handshake(hio_t* io) {
 
 static void ssl_client_handshake(hio_t* io) {
     printd("ssl client handshake...\n");
-    int ret = hssl_connect(io->ssl);
+    int ret = hssl_connect(io->ext->ssl);
     if (ret == 0) {
         // handshake finish
         iowatcher_del_event(io->loop, io->fd, HV_READ);
@@ -140,7 +171,7 @@ static void nio_accept(hio_t* io) {
     socklen_t addrlen;
 accept:
     addrlen = sizeof(sockaddr_u);
-    connfd = accept(io->fd, io->peeraddr, &addrlen);
+    connfd = accept(io->fd, &io->peeraddr.sa, &addrlen);
     hio_t* connio = NULL;
     if (connfd < 0) {
         err = socket_errno();
@@ -154,17 +185,17 @@ accept:
         }
     }
     addrlen = sizeof(sockaddr_u);
-    getsockname(connfd, io->localaddr, &addrlen);
+    getsockname(connfd, &io->localaddr.sa, &addrlen);
     connio = hio_get(io->loop, connfd);
     // NOTE: inherit from listenio
     connio->accept_cb = io->accept_cb;
     connio->userdata = io->userdata;
-    if (io->unpack_setting) {
-        hio_set_unpack(connio, io->unpack_setting);
+    if (io->ext && io->ext->unpack_setting) {
+        hio_set_unpack(connio, io->ext->unpack_setting);
     }
 
     if (io->io_type == HIO_TYPE_SSL) {
-        if (connio->ssl == NULL) {
+        if (hio_get_ssl(connio) == NULL) {
             hssl_ctx_t ssl_ctx = hssl_ctx_instance();
             if (ssl_ctx == NULL) {
                 goto accept_error;
@@ -173,7 +204,7 @@ accept:
             if (ssl == NULL) {
                 goto accept_error;
             }
-            connio->ssl = ssl;
+            hio_get_ext(connio)->ssl = ssl;
         }
         hio_enable_ssl(connio);
         ssl_server_handshake(connio);
@@ -192,7 +223,7 @@ accept_error:
 static void nio_connect(hio_t* io) {
     // printd("nio_connect connfd=%d\n", io->fd);
     socklen_t addrlen = sizeof(sockaddr_u);
-    int ret = getpeername(io->fd, io->peeraddr, &addrlen);
+    int ret = getpeername(io->fd, &io->peeraddr.sa, &addrlen);
     if (ret < 0) {
         io->error = socket_errno();
         printd("connect failed: %s: %d\n", strerror(io->error), io->error);
@@ -200,10 +231,10 @@ static void nio_connect(hio_t* io) {
     }
     else {
         addrlen = sizeof(sockaddr_u);
-        getsockname(io->fd, io->localaddr, &addrlen);
+        getsockname(io->fd, &io->localaddr.sa, &addrlen);
 
         if (io->io_type == HIO_TYPE_SSL) {
-            if (io->ssl == NULL) {
+            if (hio_get_ssl(io) == NULL) {
                 hssl_ctx_t ssl_ctx = hssl_ctx_instance();
                 if (ssl_ctx == NULL) {
                     goto connect_failed;
@@ -212,7 +243,7 @@ static void nio_connect(hio_t* io) {
                 if (ssl == NULL) {
                     goto connect_failed;
                 }
-                io->ssl = ssl;
+                hio_get_ext(io)->ssl = ssl;
             }
             ssl_client_handshake(io);
         }
@@ -232,7 +263,7 @@ static int __nio_read(hio_t* io, void* buf, int len) {
     int nread = 0;
     switch (io->io_type) {
     case HIO_TYPE_SSL:
-        nread = hssl_read(io->ssl, buf, len);
+        nread = hssl_read(io->ext->ssl, buf, len);
         break;
     case HIO_TYPE_TCP:
 #ifdef OS_UNIX
@@ -246,7 +277,7 @@ static int __nio_read(hio_t* io, void* buf, int len) {
     case HIO_TYPE_IP:
     {
         socklen_t addrlen = sizeof(sockaddr_u);
-        nread = recvfrom(io->fd, buf, len, 0, io->peeraddr, &addrlen);
+        nread = recvfrom(io->fd, buf, len, 0, &io->peeraddr.sa, &addrlen);
     }
         break;
     default:
@@ -261,7 +292,7 @@ static int __nio_write(hio_t* io, const void* buf, int len) {
     int nwrite = 0;
     switch (io->io_type) {
     case HIO_TYPE_SSL:
-        nwrite = hssl_write(io->ssl, buf, len);
+        nwrite = hssl_write(io->ext->ssl, buf, len);
         break;
     case HIO_TYPE_TCP:
 #ifdef OS_UNIX
@@ -273,7 +304,7 @@ static int __nio_write(hio_t* io, const void* buf, int len) {
     case HIO_TYPE_UDP:
     case HIO_TYPE_KCP:
     case HIO_TYPE_IP:
-        nwrite = sendto(io->fd, buf, len, 0, io->peeraddr, SOCKADDR_LEN(io->peeraddr));
+        nwrite = sendto(io->fd, buf, len, 0, &io->peeraddr.sa, SOCKADDR_LEN(&io->peeraddr));
         break;
     default:
         nwrite = write(io->fd, buf, len);
@@ -322,7 +353,8 @@ read:
         }
     } else {
         __read_cb(io, buf, nread);
-        if (nread == len) {
+        // NOTE: read_cb may stop reading, e.g. read_once or backpressure
+        if (nread == len && (io->events & HV_READ) && !io->closed) {
             goto read;
         }
     }
@@ -335,10 +367,10 @@ disconnect:
 static void nio_write(hio_t* io) {
     // printd("nio_write fd=%d\n", io->fd);
     int nwrite = 0, err = 0;
-    hrecursive_mutex_lock(&io->write_mutex);
+    hio_write_lock(io);
 write:
     if (write_queue_empty(&io->write_queue)) {
-        hrecursive_mutex_unlock(&io->write_mutex);
+        hio_write_unlock(io);
         if (io->close) {
             io->close = 0;
             hio_close(io);
@@ -354,7 +386,7 @@ write:
         err = socket_errno();
         if (err == EAGAIN) {
             //goto write_done;
-            hrecursive_mutex_unlock(&io->write_mutex);
+            hio_write_unlock(io);
             return;
         } else {
             // perror("write");
@@ -365,20 +397,26 @@ write:
     if (nwrite == 0) {
         goto disconnect;
     }
-    __write_cb(io, buf, nwrite);
+    // NOTE: update write_queue before write_cb, which may write more
     pbuf->offset += nwrite;
     io->write_queue_bytes -= nwrite;
     if (nwrite == len) {
-        HV_FREE(pbuf->base);
+        char* base = pbuf->base;
         write_queue_pop_front(&io->write_queue);
+        __write_cb(io, buf, nwrite);
+        HV_FREE(base);
+        // NOTE: after pbuf done, low_water_cb may write more
+        __write_low_water(io);
         // write next
         goto write;
     }
-    hrecursive_mutex_unlock(&io->write_mutex);
+    __write_cb(io, buf, nwrite);
+    __write_low_water(io);
+    hio_write_unlock(io);
     return;
 write_error:
 disconnect:
-    hrecursive_mutex_unlock(&io->write_mutex);
+    hio_write_unlock(io);
     hio_close(io);
 }
 
@@ -394,12 +432,12 @@ static void hio_handle_events(hio_t* io) {
 
     if ((io->events & HV_WRITE) && (io->revents & HV_WRITE)) {
         // NOTE: del HV_WRITE, if write_queue empty
-        hrecursive_mutex_lock(&io->write_mutex);
+        hio_write_lock(io);
         if (write_queue_empty(&io->write_queue)) {
             iowatcher_del_event(io->loop, io->fd, HV_WRITE);
             io->events &= ~HV_WRITE;
         }
-        hrecursive_mutex_unlock(&io->write_mutex);
+        hio_write_unlock(io);
         if (io->connect) {
             // NOTE: connect just do once
             // ONESHOT
@@ -415,6 +453,119 @@ static void hio_handle_events(hio_t* io) {
     io->revents = 0;
 }
 
+#ifdef OS_LINUX
+// splice: io => io->ext->splice_pipe => io->upstream_io, no copy through user space.
+// NOTE: io is read only when its pipe is empty, so the pipe never fills,
+// and reading stops while the pipe waits for upstream_io writable.
+// NOTE: EOF of io is passed on to upstream_io as half-close, and
+// upstream_io => io goes on, so what is in or behind the pipe to io is
+// not lost, like a write_queue drained before close. Closed on EOF of both.
+static void hio_splice_events(hio_t* io);
+
+// pipe of io->upstream_io => io
+static void nio_splice_write(hio_t* io) {
+    hio_t* src = io->ext->upstream_io;
+    struct hio_ext_s* src_ext = src->ext;
+    while (src_ext->splice_pipe_bytes) {
+        ssize_t nwrite = splice(src_ext->splice_pipe[0], NULL, io->fd, NULL,
+                src_ext->splice_pipe_bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (nwrite < 0) {
+            if (errno == EAGAIN) break;
+            io->error = errno;
+            hio_close(io);
+            return;
+        }
+        src_ext->splice_pipe_bytes -= nwrite;
+        if (io->keepalive_timer) {
+            htimer_reset(io->keepalive_timer);
+        }
+    }
+    if (src_ext->splice_pipe_bytes) {
+        hio_del(src, HV_READ);
+        hio_add(io, hio_splice_events, HV_WRITE);
+    } else {
+        if (io->events & HV_WRITE) {
+            hio_del(io, HV_WRITE);
+        }
+        if (!src_ext->splice_eof && !(src->events & HV_READ)) {
+            hio_add(src, hio_splice_events, HV_READ);
+        }
+    }
+}
+
+// io => pipe of io
+static void nio_splice_read(hio_t* io) {
+    struct hio_ext_s* ext = io->ext;
+    ssize_t nread = splice(io->fd, NULL, ext->splice_pipe[1], NULL,
+            HIO_SPLICE_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (nread < 0) {
+        if (errno == EAGAIN) return;
+        io->error = errno;
+        hio_close(io);
+        return;
+    }
+    if (nread == 0) {
+        hio_t* upstream_io = ext->upstream_io;
+        if (upstream_io->ext->splice_eof) {
+            hio_close(io);
+            return;
+        }
+        // NOTE: the pipe of io is empty here, as io is read only then
+        ext->splice_eof = 1;
+        hio_del(io, HV_READ);
+        shutdown(upstream_io->fd, SHUT_WR);
+        // NOTE: closed by close_timeout, if upstream_io does not EOF in time
+        if (ext->close_timer == NULL) {
+            int timeout_ms = ext->close_timeout ? ext->close_timeout : HIO_DEFAULT_CLOSE_TIMEOUT;
+            ext->close_timer = htimer_add(io->loop, __close_timeout_cb, timeout_ms, 1);
+            ext->close_timer->privdata = io;
+        }
+        return;
+    }
+    ext->splice_pipe_bytes += nread;
+    if (io->keepalive_timer) {
+        htimer_reset(io->keepalive_timer);
+    }
+    nio_splice_write(ext->upstream_io);
+}
+
+static void hio_splice_events(hio_t* io) {
+    if ((io->events & HV_READ) && (io->revents & HV_READ)) {
+        nio_splice_read(io);
+    }
+    if (!io->closed && (io->events & HV_WRITE) && (io->revents & HV_WRITE)) {
+        nio_splice_write(io);
+    }
+    io->revents = 0;
+}
+
+static int hio_splice_init(hio_t* io) {
+    struct hio_ext_s* ext = hio_get_ext(io);
+    if (ext->splice) return 0;
+    if (pipe2(ext->splice_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        hloge("pipe2 error: %d", errno);
+        return -1;
+    }
+    ext->splice = 1;
+    ext->splice_eof = 0;
+    ext->splice_pipe_bytes = 0;
+    return 0;
+}
+
+int hio_splice_upstream(hio_t* io) {
+    hio_t* upstream_io = hio_get_upstream(io);
+    if (upstream_io == NULL) return -1;
+    // NOTE: plain TCP only, SSL/UDP/unpack need the data in user space
+    if (io->io_type != HIO_TYPE_TCP || upstream_io->io_type != HIO_TYPE_TCP) return -1;
+    if (io->read_cb != hio_write_upstream || upstream_io->read_cb != hio_write_upstream) return -1;
+    if (io->ext->unpack_setting || upstream_io->ext->unpack_setting) return -1;
+    if (hio_splice_init(io) != 0 || hio_splice_init(upstream_io) != 0) return -1;
+    hio_add(io, hio_splice_events, HV_READ);
+    hio_add(upstream_io, hio_splice_events, HV_READ);
+    return 0;
+}
+#endif
+
 int hio_accept(hio_t* io) {
     io->accept = 1;
     hio_add(io, hio_handle_events, HV_READ);
@@ -422,7 +573,7 @@ int hio_accept(hio_t* io) {
 }
 
 int hio_connect(hio_t* io) {
-    int ret = connect(io->fd, io->peeraddr, SOCKADDR_LEN(io->peeraddr));
+    int ret = connect(io->fd, &io->peeraddr.sa, SOCKADDR_LEN(&io->peeraddr));
 #ifdef OS_WIN
     if (ret < 0 && socket_errno() != WSAEWOULDBLOCK) {
 #else
@@ -437,9 +588,10 @@ int hio_connect(hio_t* io) {
         nio_connect(io);
         return 0;
     }
-    int timeout = io->connect_timeout ? io->connect_timeout : HIO_DEFAULT_CONNECT_TIMEOUT;
-    io->connect_timer = htimer_add(io->loop, __connect_timeout_cb, timeout, 1);
-    io->connect_timer->privdata = io;
+    struct hio_ext_s* ext = hio_get_ext(io);
+    int timeout = ext->connect_timeout ? ext->connect_timeout : HIO_DEFAULT_CONNECT_TIMEOUT;
+    ext->connect_timer = htimer_add(io->loop, __connect_timeout_cb, timeout, 1);
+    ext->connect_timer->privdata = io;
     io->connect = 1;
     return hio_add(io, hio_handle_events, HV_WRITE);
 }
@@ -462,6 +614,58 @@ static void hio_write_event_cb(hevent_t* ev) {
     }
 }
 
+static void __write_keepalive(hio_t* io) {
+    if (io->keepalive_timer) {
+        if (hv_gettid() == io->loop->tid) {
+            htimer_reset(io->keepalive_timer);
+        } else {
+            hevent_t ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.cb = hio_write_event_cb;
+            ev.userdata = io;
+            ev.privdata = (void*)(uintptr_t)io->id;
+            ev.priority = HEVENT_HIGH_PRIORITY;
+            hloop_post_event(io->loop, &ev);
+        }
+    }
+}
+
+// NOTE: copy bufs except the first skip bytes into write_queue, locked by caller.
+static void __write_queue_push(hio_t* io, const hbuf_t* bufs, int nbufs, size_t skip) {
+    size_t len = 0;
+    for (int i = 0; i < nbufs; ++i) {
+        len += bufs[i].len;
+    }
+    if (skip >= len) return;
+    offset_buf_t remain;
+    remain.len = len - skip;
+    remain.offset = 0;
+    // NOTE: free in nio_write
+    HV_ALLOC(remain.base, remain.len);
+    char* dst = remain.base;
+    for (int i = 0; i < nbufs; ++i) {
+        if (skip >= bufs[i].len) {
+            skip -= bufs[i].len;
+            continue;
+        }
+        memcpy(dst, bufs[i].base + skip, bufs[i].len - skip);
+        dst += bufs[i].len - skip;
+        skip = 0;
+    }
+    if (io->write_queue.maxsize == 0) {
+        write_queue_init(&io->write_queue, 4);
+    }
+    write_queue_push_back(&io->write_queue, &remain);
+    io->write_queue_bytes += remain.len;
+    __write_high_water(io);
+    if (io->write_queue_bytes > WRITE_QUEUE_HIGH_WATER) {
+        hlogw("write queue %u, total %u, over high water %u",
+            (unsigned int)remain.len,
+            (unsigned int)io->write_queue_bytes,
+            (unsigned int)WRITE_QUEUE_HIGH_WATER);
+    }
+}
+
 int hio_write (hio_t* io, const void* buf, size_t len) {
     if (io->closed) {
         hloge("hio_write called but fd[%d] already closed!", io->fd);
@@ -473,7 +677,7 @@ int hio_write (hio_t* io, const void* buf, size_t len) {
     }
 #endif
     int nwrite = 0, err = 0;
-    hrecursive_mutex_lock(&io->write_mutex);
+    hio_write_lock(io);
     if (write_queue_empty(&io->write_queue)) {
 try_write:
         nwrite = __nio_write(io, buf, len);
@@ -495,84 +699,144 @@ try_write:
         }
 
         // __write_cb(io, buf, nwrite);
-        if (io->keepalive_timer) {
-            if (hv_gettid() == io->loop->tid) {
-                htimer_reset(io->keepalive_timer);
-            } else {
-                hevent_t ev;
-                memset(&ev, 0, sizeof(ev));
-                ev.cb = hio_write_event_cb;
-                ev.userdata = io;
-                ev.privdata = (void*)(uintptr_t)io->id;
-                ev.priority = HEVENT_HIGH_PRIORITY;
-                hloop_post_event(io->loop, &ev);
-            }
+        __write_keepalive(io);
+        if (nwrite < len) {
+            // NOTE: enqueue remain before write_cb, which may write more
+            hbuf_t remain;
+            remain.base = (char*)buf;
+            remain.len = len;
+            hio_add(io, hio_handle_events, HV_WRITE);
+            __write_queue_push(io, &remain, 1, nwrite);
         }
         hio_write_cb(io, buf, nwrite);
-
-        if (nwrite == len) {
-            //goto write_done;
-            hrecursive_mutex_unlock(&io->write_mutex);
-            return nwrite;
-        }
+        hio_write_unlock(io);
+        return nwrite;
 enqueue:
         hio_add(io, hio_handle_events, HV_WRITE);
     }
     if (nwrite < len) {
-        offset_buf_t remain;
+        hbuf_t remain;
+        remain.base = (char*)buf;
         remain.len = len;
-        remain.offset = nwrite;
-        // NOTE: free in nio_write
-        HV_ALLOC(remain.base, remain.len);
-        memcpy(remain.base, buf, remain.len);
-        if (io->write_queue.maxsize == 0) {
-            write_queue_init(&io->write_queue, 4);
-        }
-        write_queue_push_back(&io->write_queue, &remain);
-        io->write_queue_bytes += remain.len - remain.offset;
-        if (io->write_queue_bytes > WRITE_QUEUE_HIGH_WATER) {
-            hlogw("write queue %u, total %u, over high water %u",
-                (unsigned int)(remain.len - remain.offset),
-                (unsigned int)io->write_queue_bytes,
-                (unsigned int)WRITE_QUEUE_HIGH_WATER);
-        }
-    }
-    hrecursive_mutex_unlock(&io->write_mutex);
+        __write_queue_push(io, &remain, 1, nwrite);
+    }
+    hio_write_unlock(io);
     return nwrite;
 write_error:
 disconnect:
-    hrecursive_mutex_unlock(&io->write_mutex);
+    hio_write_unlock(io);
     hio_close(io);
     return nwrite;
 }
 
+static int hio_writev_merged(hio_t* io, const hbuf_t* bufs, int nbufs) {
+    size_t len = 0;
+    for (int i = 0; i < nbufs; ++i) {
+        len += bufs[i].len;
+    }
+    char* buf = NULL;
+    HV_ALLOC(buf, len);
+    char* dst = buf;
+    for (int i = 0; i < nbufs; ++i) {
+        memcpy(dst, bufs[i].base, bufs[i].len);
+        dst += bufs[i].len;
+    }
+    int nwrite = hio_write(io, buf, len);
+    HV_FREE(buf);
+    return nwrite;
+}
+
+int hio_writev(hio_t* io, const hbuf_t* bufs, int nbufs) {
+    if (io->closed) {
+        hloge("hio_writev called but fd[%d] already closed!", io->fd);
+        return -1;
+    }
+    if (nbufs == 1) {
+        return hio_write(io, bufs[0].base, bufs[0].len);
+    }
+#ifdef OS_UNIX
+    // NOTE: SSL/UDP/KCP write one record/packet per call, so merge bufs.
+    if (io->io_type != HIO_TYPE_TCP || nbufs > HIO_WRITEV_MAX_BUFS) {
+        return hio_writev_merged(io, bufs, nbufs);
+    }
+    struct iovec iov[HIO_WRITEV_MAX_BUFS];
+    size_t len = 0;
+    for (int i = 0; i < nbufs; ++i) {
+        iov[i].iov_base = bufs[i].base;
+        iov[i].iov_len = bufs[i].len;
+        len += bufs[i].len;
+    }
+    int nwrite = 0, err = 0;
+    hio_write_lock(io);
+    if (write_queue_empty(&io->write_queue)) {
+        nwrite = writev(io->fd, iov, nbufs);
+        // printd("writev retval=%d\n", nwrite);
+        if (nwrite < 0) {
+            err = socket_errno();
+            if (err == EAGAIN) {
+                nwrite = 0;
+            } else {
+                io->error = err;
+                goto write_error;
+            }
+        }
+        if (nwrite < len) {
+            // NOTE: enqueue remain before write_cb, which may write more
+            hio_add(io, hio_handle_events, HV_WRITE);
+            __write_queue_push(io, bufs, nbufs, nwrite);
+        }
+        if (nwrite > 0) {
+            __write_keepalive(io);
+            size_t remain = nwrite;
+            for (int i = 0; i < nbufs && remain; ++i) {
+                size_t n = MIN(remain, bufs[i].len);
+                hio_write_cb(io, bufs[i].base, n);
+                remain -= n;
+            }
+        }
+        hio_write_unlock(io);
+        return nwrite;
+    }
+    __write_queue_push(io, bufs, nbufs, nwrite);
+    hio_write_unlock(io);
+    return nwrite;
+write_error:
+    hio_write_unlock(io);
+    hio_close(io);
+    return nwrite;
+#else
+    return hio_writev_merged(io, bufs, nbufs);
+#endif
+}
+
 int hio_close (hio_t* io) {
     if (io->closed) return 0;
     if (hv_gettid() != io->loop->tid) {
         return hio_close_async(io);
     }
-    hrecursive_mutex_lock(&io->write_mutex);
+    hio_write_lock(io);
     if (!write_queue_empty(&io->write_queue) && io->error == 0 && io->close == 0) {
-        hrecursive_mutex_unlock(&io->write_mutex);
+        hio_write_unlock(io);
         io->close = 1;
         hlogw("write_queue not empty, close later.");
-        int timeout_ms = io->close_timeout ? io->close_timeout : HIO_DEFAULT_CLOSE_TIMEOUT;
-        io->close_timer = htimer_add(io->loop, __close_timeout_cb, timeout_ms, 1);
-        io->close_timer->privdata = io;
+        struct hio_ext_s* ext = hio_get_ext(io);
+        int timeout_ms = ext->close_timeout ? ext->close_timeout : HIO_DEFAULT_CLOSE_TIMEOUT;
+        ext->close_timer = htimer_add(io->loop, __close_timeout_cb, timeout_ms, 1);
+        ext->close_timer->privdata = io;
         return 0;
     }
 
     io->closed = 1;
     hio_done(io);
     __close_cb(io);
-    if (io->ssl) {
-        hssl_free(io->ssl);
-        io->ssl = NULL;
+    if (io->ext && io->ext->ssl) {
+        hssl_free(io->ext->ssl);
+        io->ext->ssl = NULL;
     }
     if (io->io_type & HIO_TYPE_SOCKET) {
         closesocket(io->fd);
     }
-    hrecursive_mutex_unlock(&io->write_mutex);
+    hio_write_unlock(io);
     return 0;
 }
 #endif
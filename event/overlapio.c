@@ -103,20 +103,20 @@ static void on_acceptex_complete(hio_t* io) {
     socklen_t peeraddrlen;
     GetAcceptExSockaddrs(hovlp->buf.buf, 0, sizeof(struct sockaddr_in6), sizeof(struct sockaddr_in6),
         &plocaladdr, &localaddrlen, &ppeeraddr, &peeraddrlen);
-    memcpy(io->localaddr, plocaladdr, localaddrlen);
-    memcpy(io->peeraddr, ppeeraddr, peeraddrlen);
+    memcpy(&io->localaddr, plocaladdr, localaddrlen);
+    memcpy(&io->peeraddr, ppeeraddr, peeraddrlen);
     if (io->accept_cb) {
         setsockopt(connfd, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, (const char*)&listenfd, sizeof(int));
         hio_t* connio = hio_get(io->loop, connfd);
         connio->userdata = io->userdata;
-        memcpy(connio->localaddr, io->localaddr, localaddrlen);
-        memcpy(connio->peeraddr, io->peeraddr, peeraddrlen);
+        memcpy(&connio->localaddr, &io->localaddr, localaddrlen);
+        memcpy(&connio->peeraddr, &io->peeraddr, peeraddrlen);
         /*
         char localaddrstr[SOCKADDR_STRLEN] = {0};
         char peeraddrstr[SOCKADDR_STRLEN] = {0};
         printd("accept listenfd=%d connfd=%d [%s] <= [%s]\n", listenfd, connfd,
-                SOCKADDR_STR(connio->localaddr, localaddrstr),
-                SOCKADDR_STR(connio->peeraddr, peeraddrstr));
+                SOCKADDR_STR(&connio->localaddr, localaddrstr),
+                SOCKADDR_STR(&connio->peeraddr, peeraddrstr));
         */
         //printd("accept_cb------\n");
         io->accept_cb(connio);
@@ -137,15 +137,15 @@ static void on_connectex_complete(hio_t* io) {
     if (io->connect_cb) {
         setsockopt(io->fd, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, NULL, 0);
         socklen_t addrlen = sizeof(struct sockaddr_in6);
-        getsockname(io->fd, io->localaddr, &addrlen);
+        getsockname(io->fd, &io->localaddr.sa, &addrlen);
         addrlen = sizeof(struct sockaddr_in6);
-        getpeername(io->fd, io->peeraddr, &addrlen);
+        getpeername(io->fd, &io->peeraddr.sa, &addrlen);
         /*
         char localaddrstr[SOCKADDR_STRLEN] = {0};
         char peeraddrstr[SOCKADDR_STRLEN] = {0};
         printd("connect connfd=%d [%s] => [%s]\n", io->fd,
-                SOCKADDR_STR(io->localaddr, localaddrstr),
-                SOCKADDR_STR(io->peeraddr, peeraddrstr));
+                SOCKADDR_STR(&io->localaddr, localaddrstr),
+                SOCKADDR_STR(&io->peeraddr, peeraddrstr));
         */
         //printd("connect_cb------\n");
         io->connect_cb(io);
@@ -277,7 +277,7 @@ int hio_connect (hio_t* io) {
     hovlp->fd = io->fd;
     hovlp->event = HV_WRITE;
     hovlp->io = io;
-    if (ConnectEx(io->fd, io->peeraddr, sizeof(struct sockaddr_in6), NULL, 0, &dwbytes, &hovlp->ovlp) != TRUE) {
+    if (ConnectEx(io->fd, &io->peeraddr.sa, sizeof(struct sockaddr_in6), NULL, 0, &dwbytes, &hovlp->ovlp) != TRUE) {
         int err = WSAGetLastError();
         if (err != ERROR_IO_PENDING) {
             fprintf(stderr, "AcceptEx error: %d\n", err);
@@ -303,7 +303,7 @@ try_send:
         nwrite = send(io->fd, buf, len, 0);
     }
     else if (io->io_type == HIO_TYPE_UDP) {
-        nwrite = sendto(io->fd, buf, len, 0, io->peeraddr, sizeof(struct sockaddr_in6));
+        nwrite = sendto(io->fd, buf, len, 0, &io->peeraddr.sa, sizeof(struct sockaddr_in6));
     }
     else if (io->io_type == HIO_TYPE_IP) {
         goto WSASend;
@@ -354,7 +354,7 @@ WSASend:
         }
         else if (io->io_type == HIO_TYPE_UDP ||
                  io->io_type == HIO_TYPE_IP) {
-            ret = WSASendTo(io->fd, &hovlp->buf, 1, &dwbytes, flags, io->peeraddr, sizeof(struct sockaddr_in6), &hovlp->ovlp, NULL);
+            ret = WSASendTo(io->fd, &hovlp->buf, 1, &dwbytes, flags, &io->peeraddr.sa, sizeof(struct sockaddr_in6), &hovlp->ovlp, NULL);
         }
         else {
             ret = -1;
@@ -375,6 +375,26 @@ disconnect:
     return 0;
 }
 
+int hio_writev(hio_t* io, const hbuf_t* bufs, int nbufs) {
+    if (nbufs == 1) {
+        return hio_write(io, bufs[0].base, bufs[0].len);
+    }
+    size_t len = 0;
+    for (int i = 0; i < nbufs; ++i) {
+        len += bufs[i].len;
+    }
+    char* buf = NULL;
+    HV_ALLOC(buf, len);
+    char* dst = buf;
+    for (int i = 0; i < nbufs; ++i) {
+        memcpy(dst, bufs[i].base, bufs[i].len);
+        dst += bufs[i].len;
+    }
+    int nwrite = hio_write(io, buf, len);
+    HV_FREE(buf);
+    return nwrite;
+}
+
 int hio_close (hio_t* io) {
     if (io->closed) return 0;
     io->closed = 1;
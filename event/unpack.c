@@ -5,7 +5,7 @@
 #include "hmath.h"
 
 int hio_unpack(hio_t* io, void* buf, int readbytes) {
-    unpack_setting_t* setting = io->unpack_setting;
+    unpack_setting_t* setting = io->ext->unpack_setting;
     switch(setting->mode) {
     case UNPACK_BY_FIXED_LENGTH:
         return hio_unpack_by_fixed_length(io, buf, readbytes);
@@ -23,7 +23,7 @@ int hio_unpack_by_fixed_length(hio_t* io, void* buf, int readbytes) {
     const unsigned char* sp = (const unsigned char*)io->readbuf.base;
     assert(buf == sp + io->readbuf.offset);
     const unsigned char* ep = sp + io->readbuf.offset + readbytes;
-    unpack_setting_t* setting = io->unpack_setting;
+    unpack_setting_t* setting = io->ext->unpack_setting;
 
     int fixed_length = setting->fixed_length;
     assert(io->readbuf.len >= fixed_length);
@@ -53,7 +53,7 @@ int hio_unpack_by_delimiter(hio_t* io, void* buf, int readbytes) {
     const unsigned char* sp = (const unsigned char*)io->readbuf.base;
     assert(buf == sp + io->readbuf.offset);
     const unsigned char* ep = sp + io->readbuf.offset + readbytes;
-    unpack_setting_t* setting = io->unpack_setting;
+    unpack_setting_t* setting = io->ext->unpack_setting;
 
     unsigned char* delimiter = setting->delimiter;
     int delimiter_bytes = setting->delimiter_bytes;
@@ -108,7 +108,7 @@ int hio_unpack_by_length_field(hio_t* io, void* buf, int readbytes) {
     const unsigned char* sp = (const unsigned char*)io->readbuf.base;
     assert(buf == sp + io->readbuf.offset);
     const unsigned char* ep = sp + io->readbuf.offset + readbytes;
-    unpack_setting_t* setting = io->unpack_setting;
+    unpack_setting_t* setting = io->ext->unpack_setting;
 
     const unsigned char* p = sp;
     int remain = ep - p;
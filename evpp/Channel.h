@@ -101,6 +101,32 @@ public:
         return write(str.data(), str.size());
     }
 
+    // write data as one message, e.g. an encoded websocket frame,
+    // overridden to lock out messages of other threads.
+    virtual int writeMessage(const void* data, int size) {
+        return write(data, size);
+    }
+
+    int writev(const hbuf_t* bufs, int nbufs) {
+        if (!isOpened()) return -1;
+        return hio_writev(io_, bufs, nbufs);
+    }
+
+    // Flow control of writes:
+    // isWritable() turns false once write queue bytes reach high,
+    // and onwritable is called when the write queue drained to low.
+    // 0 means disabled.
+    // NOTE: by hio_set_write_watermark, so the state is kept by io under
+    // its write lock, and onwritable is called in loop thread.
+    void setWriteWatermark(size_t high, size_t low = 0) {
+        if (!isOpened()) return;
+        hio_set_write_watermark(io_, high, low, NULL, high ? on_write_low_water : NULL);
+    }
+
+    bool isWritable() {
+        return isOpened() && !hio_is_over_write_high_water(io_);
+    }
+
     int close(bool async = false) {
         if (!isOpened()) return -1;
         if (async) {
@@ -126,6 +152,7 @@ public:
     std::function<void(Buffer*)> onread;
     std::function<void(Buffer*)> onwrite;
     std::function<void()>        onclose;
+    std::function<void()>        onwritable;
 
 private:
     static void on_read(hio_t* io, void* data, int readbytes) {
@@ -138,12 +165,23 @@ private:
 
     static void on_write(hio_t* io, const void* data, int writebytes) {
         Channel* channel = (Channel*)hio_context(io);
-        if (channel && channel->onwrite) {
+        if (channel == NULL) return;
+        if (channel->onwrite) {
             Buffer buf((void*)data, writebytes);
             channel->onwrite(&buf);
         }
     }
 
+    static void on_write_low_water(hio_t* io) {
+        Channel* channel = (Channel*)hio_context(io);
+        if (channel == NULL) return;
+        // NOTE: copy, onwritable may reset itself when done
+        std::function<void()> onwritable = channel->onwritable;
+        if (onwritable) {
+            onwritable();
+        }
+    }
+
     static void on_close(hio_t* io) {
         Channel* channel = (Channel*)hio_context(io);
         if (channel) {
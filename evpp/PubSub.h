@@ -0,0 +1,296 @@
+#ifndef HV_PUBSUB_HPP_
+#define HV_PUBSUB_HPP_
+
+/*
+ * Topic based publish/subscribe of channels, sharded by event loop:
+ * subscribers of a topic are kept by the loop of their channel,
+ * publish posts one event per loop, and each loop writes the shared buffer
+ * to its own subscribers by Channel::writeMessage, no lock of PubSub on the
+ * way of delivery.
+ *
+ * @demo evpp/PubSub_test.cpp
+ *
+ * NOTE: buffer is written as is, so for websocket publish an encoded frame,
+ * see WebSocketChannel::buildServerFrame.
+ * NOTE: destroy PubSub after loops of subscribers stopped.
+ */
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "hloop.h"
+#include "hlog.h"
+#include "hthread.h"
+
+#include "Buffer.h"
+#include "Channel.h"
+
+namespace hv {
+
+class PubSub {
+public:
+    typedef std::function<void()> Functor;
+
+    enum SlowPolicy {
+        // skip messages until the write queue drained
+        DROP,
+        // keep the latest message only, written when the write queue drained
+        CONFLATE,
+        // close the channel
+        DISCONNECT,
+    };
+
+    // a subscriber is slow if write queue bytes over this, 0 means never
+    size_t      slow_threshold;
+    SlowPolicy  slow_policy;
+    // ms, interval to check slow subscribers with conflated message
+    int         conflate_interval;
+
+    PubSub() {
+        slow_threshold = 1 << 20; // 1M
+        slow_policy = DROP;
+        conflate_interval = 100;
+        shards_.reset(new ShardList);
+    }
+
+    // NOTE: thread-safe, done in the loop of channel,
+    // unsubscribe is always queued, so it is safe to call in callbacks.
+    void subscribe(const std::string& topic, const SocketChannelPtr& channel) {
+        if (!channel || !channel->isOpened()) return;
+        ShardPtr shard = getShard(hevent_loop(channel->io()), true);
+        runInLoop(shard->loop, [shard, topic, channel]() {
+            Subscriber& sub = shard->topics[topic][channel->id()];
+            sub.channel = channel;
+        });
+    }
+
+    void unsubscribe(const std::string& topic, const SocketChannelPtr& channel) {
+        if (!channel || channel->io() == NULL) return;
+        ShardPtr shard = getShard(hevent_loop(channel->io()));
+        if (shard == NULL) return;
+        uint32_t id = channel->id();
+        queueInLoop(shard->loop, [shard, topic, id]() {
+            auto iter = shard->topics.find(topic);
+            if (iter == shard->topics.end()) return;
+            iter->second.erase(id);
+            if (iter->second.empty()) {
+                shard->topics.erase(iter);
+            }
+        });
+    }
+
+    // all topics of channel, call it in onclose,
+    // or subscribers of closed channels are removed on next publish.
+    void unsubscribe(const SocketChannelPtr& channel) {
+        if (!channel || channel->io() == NULL) return;
+        ShardPtr shard = getShard(hevent_loop(channel->io()));
+        if (shard == NULL) return;
+        uint32_t id = channel->id();
+        queueInLoop(shard->loop, [shard, id]() {
+            for (auto iter = shard->topics.begin(); iter != shard->topics.end();) {
+                iter->second.erase(id);
+                if (iter->second.empty()) {
+                    iter = shard->topics.erase(iter);
+                } else {
+                    ++iter;
+                }
+            }
+        });
+    }
+
+    // NOTE: thread-safe, buf is shared by subscribers, do not modify it after published.
+    // @retval number of loops posted
+    int publish(const std::string& topic, const BufferPtr& buf) {
+        std::shared_ptr<ShardList> shards;
+        {
+            // NOTE: only to copy the list, shards are added rarely
+            std::lock_guard<std::mutex> locker(mutex_);
+            shards = shards_;
+        }
+        for (auto& shard : *shards) {
+            runInLoop(shard->loop, [this, shard, topic, buf]() {
+                deliver(shard.get(), topic, buf);
+            });
+        }
+        return shards->size();
+    }
+
+    int publish(const std::string& topic, const void* data, int size) {
+        BufferPtr buf(new Buffer(size));
+        if (size > 0) memcpy(buf->data(), data, size);
+        return publish(topic, buf);
+    }
+
+    int publish(const std::string& topic, const std::string& str) {
+        return publish(topic, str.data(), str.size());
+    }
+
+private:
+    struct Subscriber {
+        SocketChannelPtr    channel;
+        // latest message if conflated
+        BufferPtr           pending;
+    };
+    typedef std::unordered_map<uint32_t, Subscriber> SubscriberMap;
+
+    // NOTE: accessed in its loop only
+    struct Shard {
+        hloop_t*                                        loop;
+        std::unordered_map<std::string, SubscriberMap>  topics;
+        // topics having conflated messages
+        std::unordered_set<std::string>                 pending_topics;
+        htimer_t*                                       timer;
+        PubSub*                                         pubsub;
+
+        Shard(hloop_t* loop, PubSub* pubsub) : loop(loop), timer(NULL), pubsub(pubsub) {}
+    };
+    typedef std::shared_ptr<Shard>  ShardPtr;
+    typedef std::vector<ShardPtr>   ShardList;
+
+    ShardPtr getShard(hloop_t* loop, bool create = false) {
+        std::lock_guard<std::mutex> locker(mutex_);
+        for (auto& shard : *shards_) {
+            if (shard->loop == loop) return shard;
+        }
+        if (!create) return NULL;
+        ShardPtr shard(new Shard(loop, this));
+        // NOTE: copy on write, publishing threads may hold the old list
+        std::shared_ptr<ShardList> shards(new ShardList(*shards_));
+        shards->push_back(shard);
+        shards_ = shards;
+        return shard;
+    }
+
+    static void runInLoop(hloop_t* loop, Functor fn) {
+        if (hloop_tid(loop) == hv_gettid()) {
+            fn();
+        } else {
+            queueInLoop(loop, std::move(fn));
+        }
+    }
+
+    static void queueInLoop(hloop_t* loop, Functor fn) {
+        hevent_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.cb = onPostEvent;
+        ev.userdata = new Functor(std::move(fn));
+        hloop_post_event(loop, &ev);
+    }
+
+    static void onPostEvent(hevent_t* ev) {
+        Functor* fn = (Functor*)hevent_userdata(ev);
+        (*fn)();
+        delete fn;
+    }
+
+    void deliver(Shard* shard, const std::string& topic, const BufferPtr& buf) {
+        auto iter = shard->topics.find(topic);
+        if (iter == shard->topics.end()) return;
+        SubscriberMap& subs = iter->second;
+        for (auto it = subs.begin(); it != subs.end();) {
+            if (write(shard, topic, it->second, buf) != 0) {
+                it = subs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (subs.empty()) {
+            shard->topics.erase(iter);
+        }
+    }
+
+    bool isSlow(const SocketChannelPtr& channel) {
+        return slow_threshold && hio_write_bufsize(channel->io()) >= slow_threshold;
+    }
+
+    // @retval -1 if subscriber should be removed
+    int write(Shard* shard, const std::string& topic, Subscriber& sub, const BufferPtr& buf) {
+        const SocketChannelPtr& channel = sub.channel;
+        if (!channel->isOpened()) return -1;
+        if (!isSlow(channel)) {
+            // NOTE: a newer message replaces the conflated one
+            sub.pending = NULL;
+            channel->writeMessage(buf->data(), buf->size());
+            return 0;
+        }
+        switch (slow_policy) {
+        case DROP:
+            break;
+        case CONFLATE:
+            sub.pending = buf;
+            shard->pending_topics.insert(topic);
+            if (shard->timer == NULL) {
+                shard->timer = htimer_add(shard->loop, onConflateTimer, conflate_interval, INFINITE);
+                hevent_set_userdata(shard->timer, shard);
+            }
+            break;
+        case DISCONNECT:
+            hlogw("pubsub: slow subscriber fd=%d of topic %s closed", channel->fd(), topic.c_str());
+            // NOTE: async, not to run onclose while iterating subscribers
+            channel->close(true);
+            return -1;
+        default:
+            break;
+        }
+        return 0;
+    }
+
+    static void onConflateTimer(htimer_t* timer) {
+        Shard* shard = (Shard*)hevent_userdata(timer);
+        PubSub* pubsub = shard->pubsub;
+        for (auto iter = shard->pending_topics.begin(); iter != shard->pending_topics.end();) {
+            bool pending = pubsub->flushPending(shard, *iter);
+            if (pending) {
+                ++iter;
+            } else {
+                iter = shard->pending_topics.erase(iter);
+            }
+        }
+        if (shard->pending_topics.empty()) {
+            htimer_del(timer);
+            shard->timer = NULL;
+        }
+    }
+
+    // @retval true if some conflated messages still pending
+    bool flushPending(Shard* shard, const std::string& topic) {
+        auto iter = shard->topics.find(topic);
+        if (iter == shard->topics.end()) return false;
+        bool pending = false;
+        SubscriberMap& subs = iter->second;
+        for (auto it = subs.begin(); it != subs.end();) {
+            Subscriber& sub = it->second;
+            if (!sub.channel->isOpened()) {
+                it = subs.erase(it);
+                continue;
+            }
+            if (sub.pending) {
+                if (isSlow(sub.channel)) {
+                    pending = true;
+                } else {
+                    sub.channel->writeMessage(sub.pending->data(), sub.pending->size());
+                    sub.pending = NULL;
+                }
+            }
+            ++it;
+        }
+        if (subs.empty()) {
+            shard->topics.erase(iter);
+        }
+        return pending;
+    }
+
+private:
+    std::mutex                  mutex_;
+    // NOTE: replaced when a shard added, never modified
+    std::shared_ptr<ShardList>  shards_;
+};
+
+}
+
+#endif // HV_PUBSUB_HPP_
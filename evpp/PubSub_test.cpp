@@ -0,0 +1,82 @@
+/*
+ * PubSub_test.cpp
+ *
+ * @build: make evpp
+ *
+ * @client: telnet 127.0.0.1 port
+ * > sub news
+ * > pub news hello
+ * > unsub news
+ *
+ */
+
+#include "TcpServer.h"
+#include "PubSub.h"
+
+using namespace hv;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s port\n", argv[0]);
+        return -10;
+    }
+    int port = atoi(argv[1]);
+
+    PubSub pubsub;
+    pubsub.slow_policy = PubSub::CONFLATE;
+
+    TcpServer srv;
+    int listenfd = srv.createsocket(port);
+    if (listenfd < 0) {
+        return -20;
+    }
+    printf("server listen on port %d, listenfd=%d ...\n", port, listenfd);
+    // one command per line
+    unpack_setting_t unpack_setting;
+    memset(&unpack_setting, 0, sizeof(unpack_setting_t));
+    unpack_setting.package_max_length = DEFAULT_PACKAGE_MAX_LENGTH;
+    unpack_setting.mode = UNPACK_BY_DELIMITER;
+    unpack_setting.delimiter[0] = '\n';
+    unpack_setting.delimiter_bytes = 1;
+    srv.setUnpack(&unpack_setting);
+    srv.onConnection = [&pubsub](const SocketChannelPtr& channel) {
+        std::string peeraddr = channel->peeraddr();
+        if (channel->isConnected()) {
+            printf("%s connected! connfd=%d tid=%ld\n", peeraddr.c_str(), channel->fd(), currentThreadEventLoop->tid());
+        } else {
+            printf("%s disconnected! connfd=%d tid=%ld\n", peeraddr.c_str(), channel->fd(), currentThreadEventLoop->tid());
+            pubsub.unsubscribe(channel);
+        }
+    };
+    srv.onMessage = [&pubsub](const SocketChannelPtr& channel, Buffer* buf) {
+        std::string line((char*)buf->data(), buf->size());
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        // cmd topic [msg]
+        std::string cmd, topic, msg;
+        size_t pos1 = line.find(' ');
+        cmd = line.substr(0, pos1);
+        if (pos1 != std::string::npos) {
+            size_t pos2 = line.find(' ', pos1 + 1);
+            topic = line.substr(pos1 + 1, pos2 == std::string::npos ? pos2 : pos2 - pos1 - 1);
+            if (pos2 != std::string::npos) {
+                msg = line.substr(pos2 + 1) + "\n";
+            }
+        }
+        if (cmd == "sub" && !topic.empty()) {
+            pubsub.subscribe(topic, channel);
+        } else if (cmd == "unsub" && !topic.empty()) {
+            pubsub.unsubscribe(topic, channel);
+        } else if (cmd == "pub" && !topic.empty()) {
+            pubsub.publish(topic, msg);
+        } else {
+            channel->write("usage: sub|unsub topic, pub topic msg\n");
+        }
+    };
+    srv.setThreadNum(4);
+    srv.start();
+
+    while (1) hv_sleep(1);
+    return 0;
+}
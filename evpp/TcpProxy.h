@@ -0,0 +1,388 @@
+#ifndef HV_TCP_PROXY_HPP_
+#define HV_TCP_PROXY_HPP_
+
+/*
+ * L4 load balancing proxy:
+ * each worker loop accepts on its own listenfd by SO_REUSEPORT,
+ * and relays a connection to a backend selected by load_balance,
+ * by hio_setup_tcp_upstream, so spliced on linux.
+ *
+ * @demo evpp/TcpProxy_test.cpp
+ *
+ * NOTE: addBackend before start.
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
+#include "hsocket.h"
+#include "hlog.h"
+#include "hstring.h"
+
+#include "EventLoopThreadPool.h"
+
+#define DEFAULT_TCP_PROXY_HEALTH_CHECK_INTERVAL 3000    // ms
+#define DEFAULT_TCP_PROXY_HEALTH_CHECK_TIMEOUT  1000    // ms
+#define TCP_PROXY_HASH_VNODES                   160     // virtual nodes per backend
+
+namespace hv {
+
+struct TcpProxyBackend {
+    std::string     host;
+    int             port;
+    sockaddr_u      addr;
+    char            ip[SOCKADDR_STRLEN];
+    // 0 means unlimited
+    uint32_t        max_connections;
+    // status
+    std::atomic<uint32_t>   connections;
+    std::atomic<bool>       healthy;
+
+    bool isAvailable() {
+        return healthy && (max_connections == 0 || connections < max_connections);
+    }
+
+    // NOTE: compare-exchange, not to overshoot max_connections by workers
+    // accepting at once, release if the connection is not set up.
+    bool acquire() {
+        if (!healthy) return false;
+        uint32_t num = connections;
+        do {
+            if (max_connections != 0 && num >= max_connections) return false;
+        } while (!connections.compare_exchange_weak(num, num + 1));
+        return true;
+    }
+
+    void release() {
+        --connections;
+    }
+};
+typedef std::shared_ptr<TcpProxyBackend> TcpProxyBackendPtr;
+
+class TcpProxy {
+public:
+    enum LoadBalance {
+        ROUND_ROBIN,
+        LEAST_CONNECTIONS,
+        // on client ip, so a client sticks to a backend while it is available
+        CONSISTENT_HASH,
+    };
+
+    LoadBalance     load_balance;
+    // ms, tcp connect to each backend on loop of first worker, 0 means disabled
+    int             health_check_interval;
+    int             health_check_timeout;
+
+    TcpProxy() {
+        load_balance = ROUND_ROBIN;
+        health_check_interval = DEFAULT_TCP_PROXY_HEALTH_CHECK_INTERVAL;
+        health_check_timeout = DEFAULT_TCP_PROXY_HEALTH_CHECK_TIMEOUT;
+        listenfd = -1;
+        port_ = 0;
+        next_idx_ = 0;
+    }
+
+    ~TcpProxy() {
+        stop(true);
+    }
+
+    //@retval 0 ok, <0 error
+    int addBackend(const char* host, int port, uint32_t max_connections = 0) {
+        TcpProxyBackendPtr backend(new TcpProxyBackend);
+        memset(&backend->addr, 0, sizeof(backend->addr));
+        // NOTE: resolve once, not to block loops by DNS per connection
+        int ret = sockaddr_set_ipport(&backend->addr, host, port);
+        if (ret != 0) {
+            hloge("tcp proxy: resolve backend %s:%d failed", host, port);
+            return -1;
+        }
+        backend->host = host;
+        backend->port = port;
+        sockaddr_ip(&backend->addr, backend->ip, sizeof(backend->ip));
+        backend->max_connections = max_connections;
+        backend->connections = 0;
+        backend->healthy = true;
+        backends.push_back(backend);
+        return 0;
+    }
+
+    //@retval >=0 listenfd of first worker, <0 error
+    int createsocket(int port, const char* host = "0.0.0.0") {
+        host_ = host;
+        port_ = port;
+        listenfd = createListenSocket();
+        return listenfd;
+    }
+
+    void setThreadNum(int num) {
+        worker_threads.setThreadNum(num);
+    }
+
+    int start(bool wait_threads_started = true) {
+        if (listenfd < 0 || backends.empty()) return -1;
+        buildHashRing();
+        std::shared_ptr<std::atomic<int>> worker_idx(new std::atomic<int>(0));
+        worker_threads.start(wait_threads_started, [this, worker_idx](const EventLoopPtr& loop) {
+            int idx = (*worker_idx)++;
+            startAccept(loop, idx);
+            if (idx == 0 && health_check_interval > 0) {
+                loop->setInterval(health_check_interval, [this, loop](TimerID timerID) {
+                    healthCheck(loop->loop());
+                });
+            }
+        });
+        return 0;
+    }
+
+    void stop(bool wait_threads_stopped = true) {
+        {
+            // NOTE: close listenios in their loops before stopping them,
+            // not to leave listenfds queueing connections by SO_REUSEPORT.
+            std::lock_guard<std::mutex> locker(listenios_mutex_);
+            for (auto listenio : listenios_) {
+                hio_close_async(listenio);
+            }
+            if (listenios_.empty() && listenfd >= 0) {
+                ::closesocket(listenfd);
+            }
+            listenios_.clear();
+            listenfd = -1;
+        }
+        worker_threads.stop(wait_threads_stopped);
+    }
+
+    size_t connectionNum() {
+        size_t num = 0;
+        for (auto& backend : backends) {
+            num += backend->connections;
+        }
+        return num;
+    }
+
+private:
+    int createListenSocket() {
+#ifdef OS_LINUX
+        // NOTE: SO_REUSEPORT balances connections over listenfds by kernel,
+        // so each worker accepts on its own listenfd, no lock, no handoff.
+        sockaddr_u addr;
+        memset(&addr, 0, sizeof(addr));
+        if (sockaddr_set_ipport(&addr, host_.c_str(), port_) != 0) return -1;
+        int fd = socket(addr.sa.sa_family, SOCK_STREAM, 0);
+        if (fd < 0) {
+            perror("socket");
+            return -1;
+        }
+        if (so_reuseaddr(fd, 1) != 0 ||
+            so_reuseport(fd, 1) != 0 ||
+            bind(fd, &addr.sa, sockaddr_len(&addr)) != 0 ||
+            listen(fd, SOMAXCONN) != 0) {
+            perror("listen");
+            ::closesocket(fd);
+            return -1;
+        }
+        return fd;
+#else
+        // NOTE: workers share one listenfd
+        if (listenfd >= 0) return listenfd;
+        return Listen(port_, host_.c_str());
+#endif
+    }
+
+    void startAccept(const EventLoopPtr& loop, int idx) {
+        int fd = idx == 0 ? listenfd : createListenSocket();
+        if (fd < 0) {
+            hloge("tcp proxy: worker %d listen on %s:%d failed", idx, host_.c_str(), port_);
+            return;
+        }
+        hio_t* listenio = haccept(loop->loop(), fd, onAccept);
+        if (listenio == NULL) {
+            if (fd != listenfd) ::closesocket(fd);
+            return;
+        }
+        hevent_set_userdata(listenio, this);
+        // NOTE: workers share listenfd unless SO_REUSEPORT, close it once
+        if (idx == 0 || fd != listenfd) {
+            std::lock_guard<std::mutex> locker(listenios_mutex_);
+            listenios_.push_back(listenio);
+        }
+    }
+
+    static void onAccept(hio_t* io) {
+        TcpProxy* proxy = (TcpProxy*)hevent_userdata(io);
+        TcpProxyBackend* backend = proxy->selectBackend(io);
+        if (backend == NULL) {
+            hlogw("tcp proxy: no backend available");
+            hio_close(io);
+            return;
+        }
+        hio_t* upstream_io = hio_setup_tcp_upstream(io, backend->ip, backend->port);
+        if (upstream_io == NULL) {
+            hio_close(io);
+        }
+        // NOTE: connect may fail at once, then io closed by hio_close_upstream
+        if (hio_is_closed(io)) {
+            backend->release();
+            return;
+        }
+        hevent_set_userdata(io, backend);
+        hio_setcb_close(io, onClose);
+    }
+
+    static void onClose(hio_t* io) {
+        TcpProxyBackend* backend = (TcpProxyBackend*)hevent_userdata(io);
+        if (backend) {
+            backend->release();
+            hevent_set_userdata(io, NULL);
+        }
+        hio_close_upstream(io);
+    }
+
+    // @return acquired backend, or NULL if none available
+    TcpProxyBackend* selectBackend(hio_t* io) {
+        size_t num = backends.size();
+        switch (load_balance) {
+        case LEAST_CONNECTIONS:
+        {
+            // NOTE: select again if the least one is full by other workers
+            for (size_t retry = 0; retry < num; ++retry) {
+                TcpProxyBackend* least = NULL;
+                // NOTE: start by round robin, not to pile on the first one while all idle
+                size_t start = next_idx_++;
+                for (size_t i = 0; i < num; ++i) {
+                    TcpProxyBackend* backend = backends[(start + i) % num].get();
+                    if (!backend->isAvailable()) continue;
+                    if (least == NULL || backend->connections < least->connections) {
+                        least = backend;
+                    }
+                }
+                if (least == NULL) return NULL;
+                if (least->acquire()) return least;
+            }
+            return NULL;
+        }
+        case CONSISTENT_HASH:
+        {
+            if (hash_ring_.empty()) return NULL;
+            uint32_t hash = hashPeerAddr(io);
+            auto iter = std::lower_bound(hash_ring_.begin(), hash_ring_.end(), std::make_pair(hash, (size_t)0));
+            // NOTE: next one on ring if unavailable, so others keep their backend
+            for (size_t i = 0; i < hash_ring_.size(); ++i, ++iter) {
+                if (iter == hash_ring_.end()) iter = hash_ring_.begin();
+                TcpProxyBackend* backend = backends[iter->second].get();
+                if (backend->acquire()) return backend;
+            }
+            return NULL;
+        }
+        case ROUND_ROBIN:
+        default:
+        {
+            size_t start = next_idx_++;
+            for (size_t i = 0; i < num; ++i) {
+                TcpProxyBackend* backend = backends[(start + i) % num].get();
+                if (backend->acquire()) return backend;
+            }
+            return NULL;
+        }
+        }
+    }
+
+    // FNV-1a, with finalizer of murmur3 to spread close keys, e.g. ips of a subnet
+    static uint32_t hash32(const void* data, size_t size) {
+        const unsigned char* p = (const unsigned char*)data;
+        uint32_t hash = 2166136261U;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= p[i];
+            hash *= 16777619U;
+        }
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6b;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    static uint32_t hashPeerAddr(hio_t* io) {
+        sockaddr_u* addr = (sockaddr_u*)hio_peeraddr(io);
+        if (addr->sa.sa_family == AF_INET6) {
+            return hash32(&addr->sin6.sin6_addr, sizeof(addr->sin6.sin6_addr));
+        }
+        return hash32(&addr->sin.sin_addr, sizeof(addr->sin.sin_addr));
+    }
+
+    void buildHashRing() {
+        hash_ring_.clear();
+        for (size_t idx = 0; idx < backends.size(); ++idx) {
+            const TcpProxyBackendPtr& backend = backends[idx];
+            std::string key = backend->host + ":" + hv::to_string(backend->port);
+            for (int i = 0; i < TCP_PROXY_HASH_VNODES; ++i) {
+                std::string vnode = key + "#" + hv::to_string(i);
+                hash_ring_.push_back(std::make_pair(hash32(vnode.data(), vnode.size()), idx));
+            }
+        }
+        std::sort(hash_ring_.begin(), hash_ring_.end());
+    }
+
+    // tcp connect: connected => healthy, closed before connected => unhealthy
+    void healthCheck(hloop_t* loop) {
+        for (auto& backend : backends) {
+            hio_t* io = hio_create_socket(loop, backend->ip, backend->port, HIO_TYPE_TCP, HIO_CLIENT_SIDE);
+            if (io == NULL) {
+                setHealthy(backend.get(), false);
+                continue;
+            }
+            hevent_set_userdata(io, backend.get());
+            hio_setcb_connect(io, onHealthCheckConnect);
+            hio_setcb_close(io, onHealthCheckClose);
+            hio_set_connect_timeout(io, health_check_timeout);
+            hio_connect(io);
+        }
+    }
+
+    static void setHealthy(TcpProxyBackend* backend, bool healthy) {
+        if (backend->healthy == healthy) return;
+        backend->healthy = healthy;
+        if (healthy) {
+            hlogi("tcp proxy: backend %s:%d up", backend->host.c_str(), backend->port);
+        } else {
+            hlogw("tcp proxy: backend %s:%d down", backend->host.c_str(), backend->port);
+        }
+    }
+
+    static void onHealthCheckConnect(hio_t* io) {
+        TcpProxyBackend* backend = (TcpProxyBackend*)hevent_userdata(io);
+        hevent_set_userdata(io, NULL);
+        setHealthy(backend, true);
+        hio_close(io);
+    }
+
+    static void onHealthCheckClose(hio_t* io) {
+        TcpProxyBackend* backend = (TcpProxyBackend*)hevent_userdata(io);
+        if (backend) {
+            setHealthy(backend, false);
+        }
+    }
+
+public:
+    int                             listenfd;
+    std::vector<TcpProxyBackendPtr> backends;
+
+private:
+    std::string                     host_;
+    int                             port_;
+    std::atomic<unsigned int>       next_idx_;
+    // sorted (hash, index of backends)
+    std::vector<std::pair<uint32_t, size_t>>    hash_ring_;
+    // listenios of workers, closed by stop
+    std::vector<hio_t*>             listenios_;
+    std::mutex                      listenios_mutex_;
+    EventLoopThreadPool             worker_threads;
+};
+
+}
+
+#endif // HV_TCP_PROXY_HPP_
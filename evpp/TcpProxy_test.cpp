@@ -0,0 +1,55 @@
+/*
+ * TcpProxy_test.cpp
+ *
+ * @build: make evpp
+ *
+ * @backend: bin/httpd -s restart -d
+ * @proxy:   bin/TcpProxy_test 8888 rr 127.0.0.1:8080 127.0.0.1:8081
+ * @client:  bin/curl -v 127.0.0.1:8888
+ *
+ */
+
+#include "TcpProxy.h"
+
+using namespace hv;
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        printf("Usage: %s port rr|lc|hash host:port [host:port ...]\n", argv[0]);
+        return -10;
+    }
+    int port = atoi(argv[1]);
+
+    TcpProxy proxy;
+    if (strcmp(argv[2], "lc") == 0) {
+        proxy.load_balance = TcpProxy::LEAST_CONNECTIONS;
+    } else if (strcmp(argv[2], "hash") == 0) {
+        proxy.load_balance = TcpProxy::CONSISTENT_HASH;
+    } else {
+        proxy.load_balance = TcpProxy::ROUND_ROBIN;
+    }
+    for (int i = 3; i < argc; ++i) {
+        std::string backend(argv[i]);
+        size_t pos = backend.rfind(':');
+        if (pos == std::string::npos) {
+            printf("invalid backend %s\n", argv[i]);
+            return -20;
+        }
+        std::string host = backend.substr(0, pos);
+        int backend_port = atoi(backend.c_str() + pos + 1);
+        if (proxy.addBackend(host.c_str(), backend_port) != 0) {
+            return -20;
+        }
+    }
+
+    int listenfd = proxy.createsocket(port);
+    if (listenfd < 0) {
+        return -30;
+    }
+    printf("proxy listen on port %d, listenfd=%d ...\n", port, listenfd);
+    proxy.setThreadNum(4);
+    proxy.start();
+
+    while (1) hv_sleep(1);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * grpc server
+ *
+ * @build   ./configure --with-nghttp2 && make clean && make
+ * @server  bin/grpc_server_test 50051
+ * @client  grpcurl -plaintext -d '{"name":"hv"}' 127.0.0.1:50051 helloworld.Greeter/SayHello
+ *
+ * NOTE: messages are raw bytes here, serialize them with protobuf in practice.
+ *
+ */
+
+#include "GrpcServer.h"
+#include "EventLoop.h"
+
+using namespace hv;
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s port\n", argv[0]);
+        return -10;
+    }
+    int port = atoi(argv[1]);
+
+    GrpcService grpc;
+    // unary: reply the request message
+    grpc.Unary("/helloworld.Greeter/SayHello", [](const GrpcCallPtr& call, const char* data, size_t size, std::string* reply) {
+        reply->assign(data, size);
+        return GRPC_STATUS_OK;
+    });
+    // server streaming: reply the request message 3 times, 1 per 100ms
+    grpc.ServerStreaming("/helloworld.Greeter/SayHelloStream", [](const GrpcCallPtr& call, const char* data, size_t size) {
+        std::string msg(data, size);
+        std::shared_ptr<int> count(new int(0));
+        setInterval(100, [call, msg, count](TimerID timerID) {
+            if (call->IsClosed() || ++*count > 3) {
+                killTimer(timerID);
+                call->Finish();
+                return;
+            }
+            call->Write(msg);
+        });
+    });
+    // bidi streaming: echo each message, finish on client half-closed
+    grpc.Streaming("/helloworld.Greeter/SayHelloChat", [](const GrpcCallPtr& call) {
+        GrpcCall* c = call.get();
+        c->onmessage = [c](const char* data, size_t size) {
+            c->Write(data, size);
+        };
+        c->onend = [c]() {
+            c->Finish();
+        };
+        c->onclose = []() {
+            printf("onclose\n");
+        };
+    });
+
+    GrpcServer server;
+    server.registerGrpcService(&grpc);
+    server.setPort(port);
+    server.setThreadNum(4);
+    server.run();
+    return 0;
+}
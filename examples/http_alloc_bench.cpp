@@ -0,0 +1,136 @@
+/*
+ * heap allocations per keep-alive request of HttpServer
+ *
+ * @build   make examples
+ *
+ * @run     bin/http_alloc_bench [port] [requests]
+ *
+ */
+
+#include <atomic>
+#include <new>
+
+#include "HttpServer.h"
+#include "hsocket.h"
+#include "hbase.h"
+#include "hlog.h"
+
+static std::atomic<long> s_alloc_cnt(0);
+
+void* operator new(size_t size) {
+    ++s_alloc_cnt;
+    void* ptr = malloc(size ? size : 1);
+    if (ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+// @return response length, -1 if failed
+static int request(int fd, const char* req, int reqlen) {
+    static char buf[65536];
+    if (send(fd, req, reqlen, 0) != reqlen) return -1;
+    int len = 0;
+    int header_len = 0;
+    int content_length = 0;
+    while (len < (int)sizeof(buf)) {
+        int nread = recv(fd, buf + len, sizeof(buf) - len, 0);
+        if (nread <= 0) return -1;
+        len += nread;
+        if (header_len == 0) {
+            const char* header_end = strstr(buf, "\r\n\r\n");
+            if (header_end == NULL) continue;
+            header_len = header_end + 4 - buf;
+            const char* p = strstr(buf, "Content-Length: ");
+            if (p && p < header_end) {
+                content_length = atoi(p + 16);
+            }
+        }
+        if (len >= header_len + content_length) return len;
+    }
+    return -1;
+}
+
+static void bench(int port, const char* path, const char* method, const char* body, int requests) {
+    int fd = ConnectTimeout("127.0.0.1", port);
+    if (fd < 0) {
+        fprintf(stderr, "connect 127.0.0.1:%d failed!\n", port);
+        return;
+    }
+    char req[1024];
+    int reqlen = snprintf(req, sizeof(req),
+        "%s %s HTTP/1.1\r\n"
+        "Host: 127.0.0.1:%d\r\n"
+        "User-Agent: http_alloc_bench\r\n"
+        "Accept: */*\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: %d\r\n"
+        "\r\n"
+        "%s",
+        method, path, port, (int)strlen(body), body);
+
+    // warm up the connection
+    for (int i = 0; i < 10; ++i) {
+        request(fd, req, reqlen);
+    }
+
+    long alloc_cnt = s_alloc_cnt;
+    for (int i = 0; i < requests; ++i) {
+        if (request(fd, req, reqlen) < 0) {
+            fprintf(stderr, "%s %s failed!\n", method, path);
+            break;
+        }
+    }
+    alloc_cnt = s_alloc_cnt - alloc_cnt;
+    printf("%-6s %-8s %8d requests %8ld allocs %8.2f allocs/request\n",
+        method, path, requests, alloc_cnt, (double)alloc_cnt / requests);
+    closesocket(fd);
+}
+
+int main(int argc, char** argv) {
+    int port = argc > 1 ? atoi(argv[1]) : 0;
+    if (port == 0) port = 8080;
+    int requests = argc > 2 ? atoi(argv[2]) : 0;
+    if (requests == 0) requests = 10000;
+
+    hlog_set_level(LOG_LEVEL_SILENT);
+
+    HttpService router;
+    router.access_log = false;
+    router.GET("/ping", [](HttpRequest* req, HttpResponse* resp) {
+        return resp->String("pong");
+    });
+    router.POST("/echo", [](const HttpContextPtr& ctx) {
+        return ctx->send(ctx->body(), ctx->type());
+    });
+    router.POST("/json", [](HttpRequest* req, HttpResponse* resp) {
+        resp->json["echo"] = req->GetJson();
+        return 200;
+    });
+    router.POST("/field", [](HttpRequest* req, HttpResponse* resp) {
+        // NOTE: only the value of key is parsed
+        resp->json["key"] = req->GetString("key");
+        return 200;
+    });
+
+    hv::HttpServer server;
+    server.registerHttpService(&router);
+    server.setPort(port);
+    server.setThreadNum(1);
+    server.start();
+    hv_delay(100);
+
+    bench(port, "/ping", "GET", "", requests);
+    bench(port, "/echo", "POST", "{\"key\":\"value\"}", requests);
+    bench(port, "/json", "POST", "{\"key\":\"value\"}", requests);
+    bench(port, "/field", "POST", "{\"key\":\"value\"}", requests);
+
+    server.stop();
+    return 0;
+}
@@ -32,6 +32,8 @@ int main(int argc, char** argv) {
     if (port == 0) port = 8080;
 
     HttpService router;
+    // release request state of keep-alive connections idle for 1s
+    router.hibernate_timeout = DEFAULT_HIBERNATE_TIMEOUT;
     router.GET("/ping", [](HttpRequest* req, HttpResponse* resp) {
         return resp->String("pong");
     });
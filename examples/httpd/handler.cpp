@@ -278,3 +278,39 @@ int Handler::upload(const HttpContextPtr& ctx) {
     }
     return response_status(ctx, status_code);
 }
+
+http_body_consumer Handler::uploadStream(const HttpContextPtr& ctx) {
+    struct upload_state {
+        HFile file;
+        std::shared_ptr<MultipartStreamParser> parser;
+    };
+    std::shared_ptr<upload_state> state(new upload_state);
+    if (ctx->is(MULTIPART_FORM_DATA)) {
+        std::string content_type = ctx->request->GetHeader("Content-Type");
+        const char* boundary = strstr(content_type.c_str(), "boundary=");
+        if (boundary == NULL) return NULL;
+        boundary += strlen("boundary=");
+        state->parser.reset(new MultipartStreamParser(boundary));
+        upload_state* s = state.get();
+        s->parser->onPartBegin = [s](const std::string& name, const std::string& filename) {
+            if (name != "file" || filename.empty()) return;
+            std::string filepath = HPath::join("html/uploads/", HPath::basename(filename));
+            s->file.open(filepath.c_str(), "wb");
+        };
+        s->parser->onPartData = [s](const char* data, size_t size) {
+            if (s->file.isopen()) s->file.write(data, size);
+        };
+        s->parser->onPartEnd = [s]() {
+            s->file.close();
+        };
+        return [state](const char* data, size_t size) {
+            return state->parser->FeedRecvData(data, size) == 0 ? 0 : HTTP_STATUS_BAD_REQUEST;
+        };
+    }
+    if (state->file.open("html/uploads/upload.txt", "wb") != 0) {
+        return NULL;
+    }
+    return [state](const char* data, size_t size) {
+        return state->file.write(data, size) == size ? 0 : HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    };
+}
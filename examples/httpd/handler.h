@@ -26,6 +26,8 @@ public:
 
     static int login(const HttpContextPtr& ctx);
     static int upload(const HttpContextPtr& ctx);
+    // streaming upload, see HttpService::StreamBody
+    static http_body_consumer uploadStream(const HttpContextPtr& ctx);
 
 private:
     static int response_status(HttpResponse* resp, int code = 200, const char* message = NULL) {
@@ -163,6 +163,59 @@ int parse_confile(const char* confile) {
     if (str.size() != 0) {
         g_http_service.index_of = str;
     }
+    // async_file_load
+    g_http_service.async_file_load = ini.Get<bool>("async_file_load");
+    // file_cache_mmap
+    g_http_service.file_cache_mmap = ini.Get<bool>("file_cache_mmap");
+    // access_log
+    str = ini.GetValue("access_log");
+    if (str.size() != 0) {
+        g_http_service.access_log = ini.Get<bool>("access_log");
+    }
+    str = ini.GetValue("access_log_file");
+    if (str.size() != 0) {
+        g_http_service.access_log_file = str;
+    }
+    str = ini.GetValue("access_log_sample");
+    if (str.size() != 0) {
+        g_http_service.access_log_sample = atoi(str.c_str());
+    }
+    // http2
+    str = ini.GetValue("http2_max_concurrent_streams");
+    if (str.size() != 0) {
+        g_http_service.http2_max_concurrent_streams = atoi(str.c_str());
+    }
+    str = ini.GetValue("http2_initial_window_size");
+    if (str.size() != 0) {
+        g_http_service.http2_initial_window_size = atoi(str.c_str());
+    }
+    // hibernate_timeout
+    str = ini.GetValue("hibernate_timeout");
+    if (str.size() != 0) {
+        g_http_service.hibernate_timeout = atoi(str.c_str());
+    }
+    // limit
+    str = ini.GetValue("limit_rate");
+    if (str.size() != 0) {
+        g_http_service.limit_rate = atoi(str.c_str());
+    }
+    str = ini.GetValue("limit_burst");
+    if (str.size() != 0) {
+        g_http_service.limit_burst = atoi(str.c_str());
+    }
+    // overload
+    str = ini.GetValue("overload_max_lag");
+    if (str.size() != 0) {
+        g_http_service.overload_max_lag = atoi(str.c_str());
+    }
+    str = ini.GetValue("overload_max_busy");
+    if (str.size() != 0) {
+        g_http_service.overload_max_busy = atoi(str.c_str());
+    }
+    str = ini.GetValue("overload_keepalive_timeout");
+    if (str.size() != 0) {
+        g_http_service.overload_keepalive_timeout = atoi(str.c_str());
+    }
     // ssl
     if (g_http_server.https_port > 0) {
         std::string crt_file = ini.GetValue("ssl_certificate");
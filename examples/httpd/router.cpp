@@ -5,6 +5,7 @@
 #include "handler.h"
 #include "hthread.h"
 #include "requests.h"
+#include "HttpEventStream.h"
 
 void Router::Register(hv::HttpService& router) {
     // preprocessor => Handler => postprocessor
@@ -97,6 +98,8 @@ void Router::Register(hv::HttpService& router) {
 
     // curl -v http://ip:port/sleep?t=1000
     router.GET("/sleep", Handler::sleep);
+    // NOTE: sleep in worker_pool instead of loop thread
+    router.Blocking("/sleep");
 
     // curl -v http://ip:port/setTimeout?t=1000
     router.GET("/setTimeout", Handler::setTimeout);
@@ -132,8 +135,43 @@ void Router::Register(hv::HttpService& router) {
 
     // curl -v http://ip:port/login -H "Content-Type:application/json" -d '{"username":"admin","password":"123456"}'
     router.POST("/login", Handler::login);
+    // NOTE: respond 429 if more than 10 logins per second
+    router.Limit("/login", 10);
+
+    // curl -v http://ip:port/limit
+    router.GET("/limit", [&router](HttpRequest* req, HttpResponse* resp) {
+        http_limit_stats* stats = router.limit_stats.get();
+        resp->json["rejected_connections"] = (uint64_t)stats->rejected_connections;
+        resp->json["rejected_requests"] = (uint64_t)stats->rejected_requests;
+        resp->json["rejected_routes"] = (uint64_t)stats->rejected_routes;
+        resp->json["overloads"] = (uint64_t)stats->overloads;
+        resp->json["shed_requests"] = (uint64_t)stats->shed_requests;
+        return 200;
+    });
 
     // curl -v http://ip:port/upload -d "hello,world!"
     // curl -v http://ip:port/upload -F "file=@LICENSE"
     router.POST("/upload", Handler::upload);
+
+    // curl -v http://ip:port/upload/stream -d "@LICENSE"
+    // curl -v http://ip:port/upload/stream -F "file=@LICENSE"
+    router.POST("/upload/stream", [](const HttpContextPtr& ctx) {
+        ctx->set("code", 200);
+        ctx->set("message", "OK");
+        return 200;
+    });
+    // NOTE: write body into file as it arrives instead of buffering into req->body
+    router.StreamBody("/upload/stream", Handler::uploadStream);
+
+    // Server-Sent Events
+    // curl -N http://ip:port/events
+    // curl -N http://ip:port/events -H "Last-Event-ID: 1"
+    static hv::HttpEventStream events;
+    router.EventStream("/events", &events);
+    // curl -v http://ip:port/events -d "hello,world!"
+    router.POST("/events", [](HttpRequest* req, HttpResponse* resp) {
+        uint64_t id = events.Publish(req->body);
+        resp->json["id"] = id;
+        return 200;
+    });
 }
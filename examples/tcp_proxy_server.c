@@ -25,6 +25,8 @@ static int  proxy_port = 80;
 static int  proxy_ssl = 0;
 
 // hloop_create_tcp_server -> on_accept -> hio_setup_tcp_upstream
+// NOTE: plain TCP is spliced on linux, see hio_splice_upstream
+// NOTE: for multiple backends with load balancing and health checks, see evpp/TcpProxy.h
 
 static void on_accept(hio_t* io) {
     /*
@@ -118,17 +118,19 @@ int on_headers_complete(http_parser* parser) {
     }
     iter = hp->parsed->headers.find("content-length");
     if (iter != hp->parsed->headers.end()) {
-        int content_length = atoi(iter->second.c_str());
-        hp->parsed->content_length = content_length;
-        int reserve_length = MIN(content_length + 1, MAX_CONTENT_LENGTH);
-        if ((!skip_body) && reserve_length > hp->parsed->body.capacity()) {
-            hp->parsed->body.reserve(reserve_length);
-        }
+        hp->parsed->content_length = atoi(iter->second.c_str());
     }
     hp->state = HP_HEADERS_COMPLETE;
+    // NOTE: head_cb may set body_cb to stream body
     if (hp->parsed->head_cb) {
         hp->parsed->head_cb(hp->parsed->headers);
     }
+    if (hp->parsed->content_length > 0 && !skip_body && !hp->parsed->body_cb) {
+        size_t reserve_length = MIN(hp->parsed->content_length + 1, MAX_CONTENT_LENGTH);
+        if (reserve_length > hp->parsed->body.capacity()) {
+            hp->parsed->body.reserve(reserve_length);
+        }
+    }
     return skip_body ? 1 : 0;
 }
 
@@ -145,7 +147,7 @@ int on_chunk_header(http_parser* parser) {
     hp->state = HP_CHUNK_HEADER;
     int chunk_size = parser->content_length;
     int reserve_size = MIN(chunk_size + 1, MAX_CONTENT_LENGTH);
-    if (reserve_size > hp->parsed->body.capacity()) {
+    if (!hp->parsed->body_cb && reserve_size > hp->parsed->body.capacity()) {
         hp->parsed->body.reserve(reserve_size);
     }
     return 0;
@@ -36,19 +36,46 @@ static int on_data_chunk_recv_callback(nghttp2_session *session,
         size_t len, void *userdata);
 static int on_frame_recv_callback(nghttp2_session *session,
         const nghttp2_frame *frame, void *userdata);
-/*
+static int on_begin_headers_callback(nghttp2_session *session,
+        const nghttp2_frame *frame, void *userdata);
+static int on_stream_close_callback(nghttp2_session *session,
+        int32_t stream_id, uint32_t error_code, void *userdata);
 static ssize_t data_source_read_callback(nghttp2_session *session,
         int32_t stream_id, uint8_t *buf, size_t length,
         uint32_t *data_flags, nghttp2_data_source *source, void *userdata);
-*/
+
+static void make_response_nvs(HttpResponse* res, std::vector<nghttp2_nv>& nvs, char* status, int status_size) {
+    snprintf(status, status_size, "%d", res->status_code);
+    nvs.push_back(make_nv(":status", status));
+    const char* name;
+    const char* value;
+    for (auto& header : res->headers) {
+        name = header.first.c_str();
+        value = header.second.c_str();
+        strlower((char*)name);
+        if (strcmp(name, "connection") == 0) {
+            // HTTP2 default keep-alive
+            continue;
+        }
+        if (strcmp(name, "content-length") == 0) {
+            // HTTP2 have frame_hd.length
+            continue;
+        }
+        nvs.push_back(make_nv2(name, value, header.first.size(), header.second.size()));
+    }
+}
 
 
 Http2Parser::Http2Parser(http_session_type type) {
+    this->version = HTTP_V2;
+    this->type = type;
     if (cbs == NULL) {
         nghttp2_session_callbacks_new(&cbs);
         nghttp2_session_callbacks_set_on_header_callback(cbs, on_header_callback);
         nghttp2_session_callbacks_set_on_data_chunk_recv_callback(cbs, on_data_chunk_recv_callback);
         nghttp2_session_callbacks_set_on_frame_recv_callback(cbs, on_frame_recv_callback);
+        nghttp2_session_callbacks_set_on_begin_headers_callback(cbs, on_begin_headers_callback);
+        nghttp2_session_callbacks_set_on_stream_close_callback(cbs, on_stream_close_callback);
     }
     if (type == HTTP_CLIENT) {
         nghttp2_session_client_new(&session, cbs, this);
@@ -61,13 +88,14 @@ Http2Parser::Http2Parser(http_session_type type) {
     //nghttp2_session_set_user_data(session, this);
     submited = NULL;
     parsed = NULL;
+    error = 0;
     stream_id = -1;
     stream_closed = 0;
 
-    nghttp2_settings_entry settings[] = {
-        {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, 100}
-    };
-    nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, settings, ARRAY_SIZE(settings));
+    max_concurrent_streams = DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS;
+    initial_window_size = DEFAULT_HTTP2_INITIAL_WINDOW_SIZE;
+    settings_submited = false;
+    recving = false;
     state = H2_SEND_SETTINGS;
 
     //nghttp2_submit_ping(session, NGHTTP2_FLAG_NONE, NULL);
@@ -75,14 +103,41 @@ Http2Parser::Http2Parser(http_session_type type) {
 }
 
 Http2Parser::~Http2Parser() {
+    // NOTE: nghttp2_session_del does not call on_stream_close_callback
+    for (auto& pair : streams) {
+        http2_stream* stream = pair.second.get();
+        if (stream->onClose) {
+            stream->onClose(NGHTTP2_CANCEL);
+        }
+        stream->onEnd = NULL;
+        stream->onClose = NULL;
+        stream->req->body_cb = NULL;
+    }
+    streams.clear();
     if (session) {
         nghttp2_session_del(session);
         session = NULL;
     }
 }
 
+void Http2Parser::submitSettings() {
+    if (settings_submited) return;
+    settings_submited = true;
+    nghttp2_settings_entry settings[] = {
+        {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, (uint32_t)max_concurrent_streams},
+        {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, (uint32_t)initial_window_size},
+    };
+    nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, settings, ARRAY_SIZE(settings));
+    // NOTE: connection window is not changed by SETTINGS, but WINDOW_UPDATE
+    if (initial_window_size > NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE) {
+        nghttp2_session_set_local_window_size(session, NGHTTP2_FLAG_NONE, 0, initial_window_size);
+    }
+}
+
 int Http2Parser::GetSendData(char** data, size_t* len) {
+    submitSettings();
     // HTTP2_MAGIC,HTTP2_SETTINGS,HTTP2_HEADERS
+    // server: HEADERS,DATA of all streams, as flow control windows allow
     *len = nghttp2_session_mem_send(session, (const uint8_t**)data);
     printd("nghttp2_session_mem_send %d\n", *len);
     if (*len != 0) return *len;
@@ -172,9 +227,12 @@ send_done:
 }
 
 int Http2Parser::FeedRecvData(const char* data, size_t len) {
+    submitSettings();
     printd("nghttp2_session_mem_recv %d\n", len);
     state = H2_WANT_RECV;
+    recving = true;
     size_t ret = nghttp2_session_mem_recv(session, (const uint8_t*)data, len);
+    recving = false;
     if (ret != len) {
         error = ret;
     }
@@ -236,7 +294,107 @@ int Http2Parser::SubmitRequest(HttpRequest* req) {
     return 0;
 }
 
+bool Http2Parser::PopRequest(HttpRequestPtr& req, HttpResponsePtr& resp) {
+    while (!completed_streams.empty()) {
+        int32_t id = completed_streams.front();
+        completed_streams.pop_front();
+        // NOTE: stream may be reset by peer
+        http2_stream* stream = GetStream(id);
+        if (stream == NULL) continue;
+        // NOTE: stream taken over by onStreamHeaders
+        if (stream->onEnd) {
+            stream->onEnd();
+            continue;
+        }
+        stream_id = id;
+        req = stream->req;
+        resp = stream->resp;
+        return true;
+    }
+    return false;
+}
+
+http2_stream* Http2Parser::GetStream(int32_t stream_id) {
+    auto iter = streams.find(stream_id);
+    return iter == streams.end() ? NULL : iter->second.get();
+}
+
+int Http2Parser::submitStreamResponse(http2_stream* stream) {
+    HttpRequest* req = stream->req.get();
+    HttpResponse* res = stream->resp.get();
+    res->FillContentType();
+    res->FillContentLength();
+    bool grpc = req->ContentType() == APPLICATION_GRPC;
+    if (grpc && res->ContentType() != APPLICATION_GRPC) {
+        res->content_type = APPLICATION_GRPC;
+        res->headers["content-type"] = http_content_type_str(APPLICATION_GRPC);
+    }
+
+    std::vector<nghttp2_nv> nvs;
+    char c_str[256] = {0};
+    make_response_nvs(res, nvs, c_str, sizeof(c_str));
+
+    if (grpc) {
+        grpc_message_hd msghd;
+        msghd.flags = 0;
+        msghd.length = res->ContentLength();
+        grpc_message_hd_pack(&msghd, stream->grpc_hdbuf);
+        stream->grpc_hdlen = GRPC_MESSAGE_HDLEN;
+    }
+    stream->send_offset = 0;
+    nghttp2_data_provider data_prd;
+    data_prd.source.ptr = stream;
+    data_prd.read_callback = data_source_read_callback;
+    bool has_data = req->method != HTTP_HEAD && (grpc || res->ContentLength() > 0);
+    // NOTE: DATA frames are copied into nghttp2 by data_source_read_callback,
+    // so that nghttp2 can split them by flow control windows and max frame size.
+    return nghttp2_submit_response(session, stream->stream_id, &nvs[0], nvs.size(), has_data ? &data_prd : NULL);
+}
+
+int Http2Parser::SubmitStreamHeaders(int32_t stream_id, bool end_stream) {
+    http2_stream* stream = GetStream(stream_id);
+    if (stream == NULL) return NGHTTP2_ERR_INVALID_ARGUMENT;
+    std::vector<nghttp2_nv> nvs;
+    char c_str[256] = {0};
+    make_response_nvs(stream->resp.get(), nvs, c_str, sizeof(c_str));
+    if (end_stream) {
+        return nghttp2_submit_response(session, stream_id, &nvs[0], nvs.size(), NULL);
+    }
+    stream->streaming = true;
+    stream->send_end = false;
+    stream->sendbuf.clear();
+    stream->send_offset = 0;
+    nghttp2_data_provider data_prd;
+    data_prd.source.ptr = stream;
+    data_prd.read_callback = data_source_read_callback;
+    return nghttp2_submit_response(session, stream_id, &nvs[0], nvs.size(), &data_prd);
+}
+
+int Http2Parser::SendStreamData(int32_t stream_id, const void* data, size_t len) {
+    http2_stream* stream = GetStream(stream_id);
+    if (stream == NULL || !stream->streaming || stream->send_end) return NGHTTP2_ERR_INVALID_ARGUMENT;
+    stream->sendbuf.append((const char*)data, len);
+    // NOTE: failed if not deferred, that's ok
+    nghttp2_session_resume_data(session, stream_id);
+    return len;
+}
+
+int Http2Parser::SubmitStreamTrailers(int32_t stream_id, const http_headers& trailers) {
+    http2_stream* stream = GetStream(stream_id);
+    if (stream == NULL || !stream->streaming || stream->send_end) return NGHTTP2_ERR_INVALID_ARGUMENT;
+    stream->trailers = trailers;
+    stream->send_end = true;
+    nghttp2_session_resume_data(session, stream_id);
+    return 0;
+}
+
 int Http2Parser::SubmitResponse(HttpResponse* res) {
+    if (type == HTTP_SERVER) {
+        http2_stream* stream = GetStream(stream_id);
+        if (stream && stream->resp.get() == res) {
+            return submitStreamResponse(stream);
+        }
+    }
     submited = res;
 
     res->FillContentType();
@@ -255,24 +413,7 @@ int Http2Parser::SubmitResponse(HttpResponse* res) {
 
     std::vector<nghttp2_nv> nvs;
     char c_str[256] = {0};
-    snprintf(c_str, sizeof(c_str), "%d", res->status_code);
-    nvs.push_back(make_nv(":status", c_str));
-    const char* name;
-    const char* value;
-    for (auto& header : res->headers) {
-        name = header.first.c_str();
-        value = header.second.c_str();
-        strlower((char*)name);
-        if (strcmp(name, "connection") == 0) {
-            // HTTP2 default keep-alive
-            continue;
-        }
-        if (strcmp(name, "content-length") == 0) {
-            // HTTP2 have frame_hd.length
-            continue;
-        }
-        nvs.push_back(make_nv2(name, value, header.first.size(), header.second.size()));
-    }
+    make_response_nvs(res, nvs, c_str, sizeof(c_str));
     int flags = NGHTTP2_FLAG_END_HEADERS;
     // we set EOS on DATA frame
     if (stream_id == -1) {
@@ -306,6 +447,108 @@ int Http2Parser::InitRequest(HttpRequest* req) {
 
 nghttp2_session_callbacks* Http2Parser::cbs = NULL;
 
+// server: request of stream, client: parsed response
+static HttpMessage* get_parsed(Http2Parser* hp, int32_t stream_id) {
+    if (hp->type == HTTP_SERVER) {
+        http2_stream* stream = hp->GetStream(stream_id);
+        return stream ? stream->req.get() : NULL;
+    }
+    return hp->parsed;
+}
+
+int on_begin_headers_callback(nghttp2_session *session,
+    const nghttp2_frame *frame, void *userdata) {
+    Http2Parser* hp = (Http2Parser*)userdata;
+    if (hp->type != HTTP_SERVER ||
+        frame->hd.type != NGHTTP2_HEADERS ||
+        frame->headers.cat != NGHTTP2_HCAT_REQUEST) {
+        return 0;
+    }
+    printd("on_begin_headers stream_id=%d\n", frame->hd.stream_id);
+    http2_stream_ptr stream(new http2_stream(frame->hd.stream_id));
+    stream->req.reset(new HttpRequest);
+    stream->req->http_major = 2;
+    stream->req->http_minor = 0;
+    stream->resp.reset(new HttpResponse);
+    stream->resp->http_major = 2;
+    stream->resp->http_minor = 0;
+    hp->streams[frame->hd.stream_id] = stream;
+    return 0;
+}
+
+int on_stream_close_callback(nghttp2_session *session,
+    int32_t stream_id, uint32_t error_code, void *userdata) {
+    printd("on_stream_close stream_id=%d error_code=%u\n", stream_id, error_code);
+    Http2Parser* hp = (Http2Parser*)userdata;
+    http2_stream* stream = hp->GetStream(stream_id);
+    if (stream == NULL) return 0;
+    if (stream->onClose) {
+        stream->onClose(error_code);
+    }
+    // NOTE: break cycles of stream -> req -> body_cb -> owner -> req
+    stream->onEnd = NULL;
+    stream->onClose = NULL;
+    stream->req->body_cb = NULL;
+    hp->streams.erase(stream_id);
+    return 0;
+}
+
+ssize_t data_source_read_callback(nghttp2_session *session,
+    int32_t stream_id, uint8_t *buf, size_t length,
+    uint32_t *data_flags, nghttp2_data_source *source, void *userdata) {
+    http2_stream* stream = (http2_stream*)source->ptr;
+    HttpResponse* res = stream->resp.get();
+    size_t nread = 0;
+    if (stream->streaming) {
+        nread = MIN(length, stream->sendbuf.size() - stream->send_offset);
+        memcpy(buf, stream->sendbuf.data() + stream->send_offset, nread);
+        stream->send_offset += nread;
+        if (stream->send_offset < stream->sendbuf.size()) {
+            return nread;
+        }
+        stream->sendbuf.clear();
+        stream->send_offset = 0;
+        if (!stream->send_end) {
+            // NOTE: wait for SendStreamData -> nghttp2_session_resume_data
+            return nread ? nread : NGHTTP2_ERR_DEFERRED;
+        }
+        *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+        if (!stream->trailers.empty()) {
+            *data_flags |= NGHTTP2_DATA_FLAG_NO_END_STREAM;
+            std::vector<nghttp2_nv> nvs;
+            for (auto& header : stream->trailers) {
+                nvs.push_back(make_nv2(header.first.c_str(), header.second.c_str(), header.first.size(), header.second.size()));
+            }
+            nghttp2_submit_trailer(session, stream_id, &nvs[0], nvs.size());
+        }
+        return nread;
+    }
+    if (stream->grpc_hdlen) {
+        size_t n = MIN(length, stream->grpc_hdlen);
+        memcpy(buf, stream->grpc_hdbuf + GRPC_MESSAGE_HDLEN - stream->grpc_hdlen, n);
+        stream->grpc_hdlen -= n;
+        nread += n;
+    }
+    const char* content = (const char*)res->Content();
+    size_t content_length = res->ContentLength();
+    size_t n = MIN(length - nread, content_length - stream->send_offset);
+    if (n) {
+        memcpy(buf + nread, content + stream->send_offset, n);
+        stream->send_offset += n;
+        nread += n;
+    }
+    if (stream->grpc_hdlen == 0 && stream->send_offset == content_length) {
+        *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+        if (res->ContentType() == APPLICATION_GRPC) {
+            // grpc server send grpc-status in trailers
+            *data_flags |= NGHTTP2_DATA_FLAG_NO_END_STREAM;
+            nghttp2_nv nv = make_nv("grpc-status", "0");
+            nghttp2_submit_trailer(session, stream_id, &nv, 1);
+        }
+    }
+    return nread;
+}
+
 int on_header_callback(nghttp2_session *session,
     const nghttp2_frame *frame,
     const uint8_t *_name, size_t namelen,
@@ -317,10 +560,12 @@ int on_header_callback(nghttp2_session *session,
     const char* value = (const char*)_value;
     printd("%s: %s\n", name, value);
     Http2Parser* hp = (Http2Parser*)userdata;
+    HttpMessage* parsed = get_parsed(hp, frame->hd.stream_id);
+    if (parsed == NULL) return 0;
     if (*name == ':') {
-        if (hp->parsed->type == HTTP_REQUEST) {
+        if (parsed->type == HTTP_REQUEST) {
             // :method :path :scheme :authority
-            HttpRequest* req = (HttpRequest*)hp->parsed;
+            HttpRequest* req = (HttpRequest*)parsed;
             if (strcmp(name, ":method") == 0) {
                 req->method = http_method_enum(value);
             }
@@ -334,17 +579,17 @@ int on_header_callback(nghttp2_session *session,
                 req->headers["Host"] = value;
             }
         }
-        else if (hp->parsed->type == HTTP_RESPONSE) {
-            HttpResponse* res = (HttpResponse*)hp->parsed;
+        else if (parsed->type == HTTP_RESPONSE) {
+            HttpResponse* res = (HttpResponse*)parsed;
             if (strcmp(name, ":status") == 0) {
                 res->status_code = (http_status)atoi(value);
             }
         }
     }
     else {
-        hp->parsed->headers[name] = value;
+        parsed->headers[name] = value;
         if (strcmp(name, "content-type") == 0) {
-            hp->parsed->content_type = http_content_type_enum(value);
+            parsed->content_type = http_content_type_enum(value);
         }
     }
     return 0;
@@ -357,8 +602,14 @@ int on_data_chunk_recv_callback(nghttp2_session *session,
     printd("stream_id=%d length=%d\n", stream_id, (int)len);
     //printd("%.*s\n", (int)len, data);
     Http2Parser* hp = (Http2Parser*)userdata;
+    HttpMessage* parsed = get_parsed(hp, stream_id);
+    if (parsed == NULL) return 0;
+    if (parsed->body_cb) {
+        parsed->body_cb((const char*)data, len);
+        return 0;
+    }
 
-    if (hp->parsed->ContentType() == APPLICATION_GRPC) {
+    if (parsed->ContentType() == APPLICATION_GRPC) {
         // grpc_message_hd
         if (len >= GRPC_MESSAGE_HDLEN) {
             grpc_message_hd msghd;
@@ -369,7 +620,7 @@ int on_data_chunk_recv_callback(nghttp2_session *session,
             //printd("%.*s\n", (int)len, data);
         }
     }
-    hp->parsed->body.append((const char*)data, len);
+    parsed->body.append((const char*)data, len);
     return 0;
 }
 
@@ -398,6 +649,21 @@ int on_frame_recv_callback(nghttp2_session *session,
     default:
         break;
     }
+    if (hp->type == HTTP_SERVER) {
+        if (frame->hd.type == NGHTTP2_HEADERS &&
+            frame->headers.cat == NGHTTP2_HCAT_REQUEST &&
+            hp->onStreamHeaders) {
+            http2_stream* stream = hp->GetStream(frame->hd.stream_id);
+            if (stream) hp->onStreamHeaders(stream);
+        }
+        // NOTE: stream_id of server is the stream of last PopRequest
+        if ((frame->hd.type == NGHTTP2_DATA || frame->hd.type == NGHTTP2_HEADERS) &&
+            (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) &&
+            hp->GetStream(frame->hd.stream_id)) {
+            hp->completed_streams.push_back(frame->hd.stream_id);
+        }
+        return 0;
+    }
     if (frame->hd.stream_id >= hp->stream_id) {
         hp->stream_id = frame->hd.stream_id;
         hp->stream_closed = 0;
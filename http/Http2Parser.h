@@ -6,6 +6,9 @@
 #include "http2def.h"
 #include "grpcdef.h"
 
+#include <map>
+#include <deque>
+
 #include "nghttp2/nghttp2.h"
 
 enum http2_session_state {
@@ -26,6 +29,35 @@ enum http2_session_state {
     H2_RECV_DATA,
 };
 
+// server stream, one request/response per stream
+struct http2_stream {
+    int32_t         stream_id;
+    HttpRequestPtr  req;
+    HttpResponsePtr resp;
+    // for data_source_read_callback
+    unsigned char   grpc_hdbuf[GRPC_MESSAGE_HDLEN];
+    size_t          grpc_hdlen;
+    size_t          send_offset;
+    // owner of resp->content, e.g. file_cache_ptr of static file,
+    // DATA frames are read from it until the stream closed.
+    std::shared_ptr<void>   content_owner;
+
+    // streaming response: SubmitStreamHeaders -> SendStreamData -> SubmitStreamTrailers
+    bool            streaming;
+    bool            send_end;
+    std::string     sendbuf;
+    http_headers    trailers;
+
+    // set by onStreamHeaders to take over the stream,
+    // the request is not popped by PopRequest then.
+    std::function<void()>                   onEnd;      // END_STREAM received
+    std::function<void(uint32_t error_code)> onClose;   // stream closed
+
+    http2_stream(int32_t id) : stream_id(id), grpc_hdlen(0), send_offset(0),
+                               streaming(false), send_end(false) {}
+};
+typedef std::shared_ptr<http2_stream> http2_stream_ptr;
+
 class Http2Parser : public HttpParser {
 public:
     static nghttp2_session_callbacks* cbs;
@@ -41,6 +73,22 @@ public:
     // at least HTTP2_FRAME_HDLEN + GRPC_MESSAGE_HDLEN = 9 + 5 = 14
     unsigned char                   frame_hdbuf[32];
 
+    // SETTINGS, submitted before first GetSendData/FeedRecvData
+    int max_concurrent_streams;
+    int initial_window_size;
+    bool settings_submited;
+
+    // server: streams are multiplexed, streams[stream_id] is created on
+    // HEADERS and released on stream close, completed_streams are queued
+    // on END_STREAM and popped by PopRequest.
+    std::map<int32_t, http2_stream_ptr> streams;
+    std::deque<int32_t>                 completed_streams;
+    // server: called on request HEADERS, may set req->body_cb to receive
+    // DATA as it arrives, and onEnd/onClose of stream.
+    std::function<void(http2_stream* stream)> onStreamHeaders;
+    // in FeedRecvData, GetSendData must not be called then
+    bool                                recving;
+
     Http2Parser(http_session_type type = HTTP_CLIENT);
     virtual ~Http2Parser();
 
@@ -82,6 +130,25 @@ public:
     virtual int InitRequest(HttpRequest* req);
     virtual int SubmitResponse(HttpResponse* res);
 
+    // server multiplexing
+    // FeedRecvData -> while (PopRequest) {SubmitResponse} -> while(GetSendData) {send}
+    // NOTE: SubmitResponse responds to the stream of last PopRequest,
+    // DATA frames are sent as the flow control windows of peer allow.
+    bool PopRequest(HttpRequestPtr& req, HttpResponsePtr& resp);
+    http2_stream* GetStream(int32_t stream_id);
+
+    // server streaming response
+    // SubmitStreamHeaders(stream->resp) -> SendStreamData ... -> SubmitStreamTrailers
+    // @param end_stream: HEADERS only response, e.g. grpc Trailers-Only
+    int SubmitStreamHeaders(int32_t stream_id, bool end_stream = false);
+    int SendStreamData(int32_t stream_id, const void* data, size_t len);
+    // END_STREAM after sendbuf drained, with trailers if not empty
+    int SubmitStreamTrailers(int32_t stream_id, const http_headers& trailers);
+
+private:
+    void submitSettings();
+    int submitStreamResponse(http2_stream* stream);
+
 };
 
 #endif
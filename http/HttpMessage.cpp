@@ -12,6 +12,7 @@ using namespace hv;
 http_headers DefaultHeaders;
 http_body    NoBody;
 char HttpMessage::s_date[32] = {0};
+char HttpResponse::s_server[64] = {0};
 
 bool HttpCookie::parse(const std::string& str) {
     std::stringstream ss;
@@ -90,16 +91,35 @@ std::string HttpCookie::dump() const {
 }
 
 #ifndef WITHOUT_HTTP_CONTENT
+const hv::Json* HttpMessage::GetJsonValue(const char* key, hv::Json& lazy_value) {
+    if (json.empty() && body.size() != 0) {
+        // NOTE: body not parsed, find and parse the value of key only
+        const char* value = NULL;
+        size_t value_len = 0;
+        if (!find_json_field(body.data(), body.size(), key, &value, &value_len)) {
+            return NULL;
+        }
+        lazy_value = hv::Json::parse(value, value + value_len, nullptr, false);
+        return lazy_value.is_discarded() ? NULL : &lazy_value;
+    }
+    if (!json.is_object()) {
+        return NULL;
+    }
+    return &json[key];
+}
+
 // NOTE: json ignore number/string, 123/"123"
 
 std::string HttpMessage::GetString(const char* key, const std::string& defvalue) {
     switch (ContentType()) {
     case APPLICATION_JSON:
     {
-        if (!json.is_object()) {
+        hv::Json lazy_value;
+        const hv::Json* pvalue = GetJsonValue(key, lazy_value);
+        if (pvalue == NULL) {
             return defvalue;
         }
-        const auto& value = json[key];
+        const auto& value = *pvalue;
         if (value.is_string()) {
             return value;
         }
@@ -143,10 +163,12 @@ std::string HttpMessage::GetString(const char* key, const std::string& defvalue)
 template<>
 HV_EXPORT int64_t HttpMessage::Get(const char* key, int64_t defvalue) {
     if (ContentType() == APPLICATION_JSON) {
-        if (!json.is_object()) {
+        hv::Json lazy_value;
+        const hv::Json* pvalue = GetJsonValue(key, lazy_value);
+        if (pvalue == NULL) {
             return defvalue;
         }
-        const auto& value = json[key];
+        const auto& value = *pvalue;
         if (value.is_number()) {
             return value;
         }
@@ -179,10 +201,12 @@ HV_EXPORT int HttpMessage::Get(const char* key, int defvalue) {
 template<>
 HV_EXPORT double HttpMessage::Get(const char* key, double defvalue) {
     if (ContentType() == APPLICATION_JSON) {
-        if (!json.is_object()) {
+        hv::Json lazy_value;
+        const hv::Json* pvalue = GetJsonValue(key, lazy_value);
+        if (pvalue == NULL) {
             return defvalue;
         }
-        const auto& value = json[key];
+        const auto& value = *pvalue;
         if (value.is_number()) {
             return value;
         }
@@ -211,10 +235,12 @@ HV_EXPORT float HttpMessage::Get(const char* key, float defvalue) {
 template<>
 HV_EXPORT bool HttpMessage::Get(const char* key, bool defvalue) {
     if (ContentType() == APPLICATION_JSON) {
-        if (!json.is_object()) {
+        hv::Json lazy_value;
+        const hv::Json* pvalue = GetJsonValue(key, lazy_value);
+        if (pvalue == NULL) {
             return defvalue;
         }
-        const auto& value = json[key];
+        const auto& value = *pvalue;
         if (value.is_boolean()) {
             return value;
         }
@@ -309,7 +335,9 @@ void HttpMessage::FillContentLength() {
 }
 
 bool HttpMessage::IsChunked() {
-    auto iter = headers.find("Transfer-Encoding");
+    // NOTE: static key, avoid allocating a long std::string per call
+    static const std::string s_transfer_encoding("Transfer-Encoding");
+    auto iter = headers.find(s_transfer_encoding);
     return iter == headers.end() ? false : stricmp(iter->second.c_str(), "chunked") == 0;
 }
 
@@ -368,6 +396,10 @@ void HttpMessage::DumpBody() {
         return;
     }
     FillContentType();
+    DumpContent();
+}
+
+void HttpMessage::DumpContent() {
 #ifndef WITHOUT_HTTP_CONTENT
     switch(content_type) {
     case APPLICATION_JSON:
@@ -567,6 +599,42 @@ void HttpRequest::SetProxy(const char* host, int port) {
     proxy = 1;
 }
 
+bool HttpRequest::GetRanges(long total, std::vector<std::pair<long, long>>& ranges) {
+    ranges.clear();
+    auto iter = headers.find("Range");
+    if (iter == headers.end()) return false;
+    const char* p = iter->second.c_str();
+    if (strncmp(p, "bytes=", 6) != 0) return false;
+    p += 6;
+    while (*p) {
+        while (*p == ' ' || *p == ',') ++p;
+        if (*p == '\0') break;
+        long from = -1, to = -1;
+        if (IS_NUM(*p)) from = strtol(p, (char**)&p, 10);
+        if (*p != '-') goto malformed;
+        ++p;
+        if (IS_NUM(*p)) to = strtol(p, (char**)&p, 10);
+        if (*p != '\0' && *p != ',' && *p != ' ') goto malformed;
+        if (from < 0) {
+            // suffix-length: -500
+            if (to <= 0) continue;
+            from = total > to ? total - to : 0;
+            to = total - 1;
+        } else {
+            if (to >= 0 && to < from) goto malformed;
+            // unsatisfiable
+            if (from >= total) continue;
+            // open-ended: 200-
+            if (to < 0 || to >= total) to = total - 1;
+        }
+        ranges.emplace_back(from, to);
+    }
+    return true;
+malformed:
+    ranges.clear();
+    return false;
+}
+
 std::string HttpRequest::Dump(bool is_dump_headers, bool is_dump_body) {
     ParseUrl();
 
@@ -588,25 +656,232 @@ std::string HttpRequest::Dump(bool is_dump_headers, bool is_dump_body) {
 }
 
 std::string HttpResponse::Dump(bool is_dump_headers, bool is_dump_body) {
-    char c_str[256] = {0};
     std::string str;
     str.reserve(512);
-    // HTTP/1.1 200 OK\r\n
-    snprintf(c_str, sizeof(c_str), "HTTP/%d.%d %d %s\r\n",
-            (int)http_major, (int)http_minor,
-            (int)status_code, http_status_str(status_code));
-    str = c_str;
-    if (is_dump_headers) {
-        if (*s_date) {
-            headers["Date"] = s_date;
-        } else {
-            headers["Date"] = gmtime_fmt(time(NULL), c_str);
+    Dump(str, is_dump_headers, is_dump_body);
+    return str;
+}
+
+#define HEADER_IS(name, literal) \
+    (name.size() == sizeof(literal) - 1 && stricmp(name.c_str(), literal) == 0)
+
+#define APPEND_LITERAL(str, literal) str.append(literal, sizeof(literal) - 1)
+
+// headers which HttpResponse::Dump fills or overrides
+struct http_headers_scan {
+    size_t              size;
+    const std::string*  content_type;
+    const std::string*  content_length;
+    bool                chunked;
+    bool                date;
+    bool                server;
+    bool                connection;
+};
+
+static void scan_headers(const http_headers& headers, http_headers_scan* scan) {
+    memset(scan, 0, sizeof(http_headers_scan));
+    for (auto& header : headers) {
+        const std::string& name = header.first;
+        // http2 :method :path :scheme :authority :status
+        if (name.empty() || name[0] == ':') continue;
+        // %s: %s\r\n
+        scan->size += name.size() + header.second.size() + 4;
+        switch (name.size()) {
+        case 4:
+            if (HEADER_IS(name, "Date")) scan->date = true;
+            break;
+        case 6:
+            if (HEADER_IS(name, "Server")) scan->server = true;
+            break;
+        case 10:
+            if (HEADER_IS(name, "Connection")) scan->connection = true;
+            break;
+        case 12:
+            if (HEADER_IS(name, "Content-Type")) scan->content_type = &header.second;
+            break;
+        case 14:
+            if (HEADER_IS(name, "Content-Length")) scan->content_length = &header.second;
+            break;
+        case 17:
+            if (HEADER_IS(name, "Transfer-Encoding")) scan->chunked = stricmp(header.second.c_str(), "chunked") == 0;
+            break;
+        default:
+            break;
         }
-        DumpHeaders(str);
     }
-    str += "\r\n";
+}
+
+void HttpResponse::Dump(std::string& str, bool is_dump_headers, bool is_dump_body) {
+    const char* status_str = http_status_str(status_code);
+    if (!is_dump_headers) {
+        char c_str[256] = {0};
+        // HTTP/1.1 200 OK\r\n
+        snprintf(c_str, sizeof(c_str), "HTTP/%d.%d %d %s\r\n",
+                (int)http_major, (int)http_minor,
+                (int)status_code, status_str);
+        str = c_str;
+        str += "\r\n";
+        if (is_dump_body) {
+            DumpBody(str);
+        }
+        return;
+    }
+
+#ifndef WITHOUT_HTTP_CONTENT
+    // NOTE: multipart boundary is filled into headers Content-Type
+    if (content_type == MULTIPART_FORM_DATA || form.size() != 0) {
+        FillContentType();
+    }
+#endif
+    http_headers_scan scan;
+    scan_headers(headers, &scan);
+
+    // same as FillContentType, without inserting into headers
+    const char* content_type_str = NULL;
+    if (scan.content_type) {
+        content_type = http_content_type_enum(scan.content_type->c_str());
+    } else {
+#ifndef WITHOUT_HTTP_CONTENT
+        if (content_type == CONTENT_TYPE_NONE) {
+            if (json.size() != 0) {
+                content_type = APPLICATION_JSON;
+            }
+            else if (kv.size() != 0) {
+                content_type = X_WWW_FORM_URLENCODED;
+            }
+            else if (body.size() != 0) {
+                content_type = TEXT_PLAIN;
+            }
+        }
+#endif
+        if (content_type != CONTENT_TYPE_NONE) {
+            content_type_str = http_content_type_str(content_type);
+        }
+    }
+
+    // NOTE: json body is dumped into str directly, Content-Length inserted after it
+    bool dump_json_body = false;
+#ifndef WITHOUT_HTTP_CONTENT
+    dump_json_body = is_dump_body && content_type == APPLICATION_JSON &&
+                     json.size() != 0 && body.size() == 0 && this->content == NULL &&
+                     scan.content_length == NULL && !scan.chunked;
+#endif
+
+    // same as FillContentLength, without inserting into headers
+    if (scan.content_length) {
+        content_length = atoi(scan.content_length->c_str());
+    }
+    if (dump_json_body) {
+        content_length = 0;
+    }
+    else if (content_length == 0) {
+        if (body.size() == 0) DumpContent();
+        content_length = body.size();
+    }
+    char content_length_str[16] = {0};
+    if (scan.content_length == NULL && content_length != 0 && !scan.chunked) {
+        snprintf(content_length_str, sizeof(content_length_str), "%d", content_length);
+    }
+
+    const char* date_str = NULL;
+    char c_str[32] = {0};
+    if (!scan.date) {
+        date_str = *s_date ? s_date : gmtime_fmt(time(NULL), c_str);
+    }
+    bool server = (static_headers & STATIC_HEADER_SERVER) && !scan.server && *s_server;
+    const char* connection_str = NULL;
+    if (!scan.connection) {
+        if (static_headers & STATIC_HEADER_KEEPALIVE) {
+            connection_str = "keep-alive";
+        } else if (static_headers & STATIC_HEADER_CLOSE) {
+            connection_str = "close";
+        }
+    }
+
+    std::string cookies_str;
+    for (auto& cookie : cookies) {
+        cookies_str += "Set-Cookie: ";
+        cookies_str += cookie.dump();
+        cookies_str += "\r\n";
+    }
+
+    const char* content = NULL;
     if (is_dump_body) {
-        DumpBody(str);
+        content = (const char*)Content();
+    }
+
+    // first pass: size
+    // HTTP/1.1 200 OK\r\n
+    size_t size = 15 + strlen(status_str) + scan.size + cookies_str.size() + 2;
+    if (date_str)           size += 8 + strlen(date_str);
+    if (server)             size += 10 + strlen(s_server);
+    if (connection_str)     size += 14 + strlen(connection_str);
+    if (content_type_str)   size += 16 + strlen(content_type_str);
+    if (*content_length_str) size += 18 + strlen(content_length_str);
+    if (content)            size += content_length;
+    if (dump_json_body)     size += 32 + 256;
+
+    // second pass: write
+    str.clear();
+    str.reserve(size);
+    char status_line[16] = {'H', 'T', 'T', 'P', '/',
+        (char)('0' + http_major % 10), '.', (char)('0' + http_minor % 10), ' ',
+        (char)('0' + (int)status_code / 100 % 10),
+        (char)('0' + (int)status_code / 10 % 10),
+        (char)('0' + (int)status_code % 10), ' '};
+    str.append(status_line, 13);
+    str += status_str;
+    APPEND_LITERAL(str, "\r\n");
+    if (server) {
+        APPEND_LITERAL(str, "Server: ");
+        str += s_server;
+        APPEND_LITERAL(str, "\r\n");
+    }
+    if (date_str) {
+        APPEND_LITERAL(str, "Date: ");
+        str += date_str;
+        APPEND_LITERAL(str, "\r\n");
+    }
+    if (connection_str) {
+        APPEND_LITERAL(str, "Connection: ");
+        str += connection_str;
+        APPEND_LITERAL(str, "\r\n");
+    }
+    for (auto& header : headers) {
+        const std::string& name = header.first;
+        if (name.empty() || name[0] == ':') continue;
+        str += name;
+        APPEND_LITERAL(str, ": ");
+        str += header.second;
+        APPEND_LITERAL(str, "\r\n");
+    }
+    if (content_type_str) {
+        APPEND_LITERAL(str, "Content-Type: ");
+        str += content_type_str;
+        APPEND_LITERAL(str, "\r\n");
+    }
+    if (*content_length_str) {
+        APPEND_LITERAL(str, "Content-Length: ");
+        str += content_length_str;
+        APPEND_LITERAL(str, "\r\n");
+    }
+    str += cookies_str;
+#ifndef WITHOUT_HTTP_CONTENT
+    if (dump_json_body) {
+        size_t header_size = str.size();
+        APPEND_LITERAL(str, "\r\n");
+        dump_json(json, str, 2);
+        content_length = str.size() - header_size - 2;
+        // NOTE: only moves the body, no temporary body string
+        char content_length_header[32];
+        int len = snprintf(content_length_header, sizeof(content_length_header),
+                           "Content-Length: %d\r\n", content_length);
+        str.insert(header_size, content_length_header, len);
+        return;
+    }
+#endif
+    APPEND_LITERAL(str, "\r\n");
+    if (content && content_length) {
+        str.append(content, content_length);
     }
-    return str;
 }
@@ -34,6 +34,7 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <vector>
 #include <functional>
 
 #include "hexport.h"
@@ -113,11 +114,15 @@ public:
     template<typename T>
     T Get(const char* key, T defvalue = 0);
 
+    // NOTE: if json not parsed yet, only the value of key is parsed from body.
     std::string GetString(const char* key, const std::string& = "");
     bool GetBool(const char* key, bool defvalue = 0);
     int64_t GetInt(const char* key, int64_t defvalue = 0);
     double GetFloat(const char* key, double defvalue = 0);
 
+    // @retval NULL if not found
+    const hv::Json* GetJsonValue(const char* key, hv::Json& lazy_value);
+
     template<typename T>
     void Set(const char* key, const T& value) {
         switch (ContentType()) {
@@ -288,6 +293,8 @@ public:
     // structured content -> body
     void DumpBody();
     void DumpBody(std::string& str);
+    // structured content -> body, content_type known
+    void DumpContent();
     // body -> structured content
     // @retval 0:succeed
     int  ParseBody();
@@ -475,6 +482,10 @@ public:
         from = to = 0;
         return false;
     }
+    // Range: bytes=0-99,200-299,-500
+    // @param total: resolve open-ended 200- and suffix -500 by total length
+    // @retval false if no Range or malformed, true with empty ranges if none satisfiable
+    bool GetRanges(long total, std::vector<std::pair<long, long>>& ranges);
 
     // Cookie:
     void SetCookie(const HttpCookie& cookie) {
@@ -489,7 +500,16 @@ public:
 
 class HV_EXPORT HttpResponse : public HttpMessage {
 public:
+    // constant headers rendered by Dump rather than inserted into headers,
+    // NOTE: the same header in headers takes precedence.
+    enum StaticHeader {
+        STATIC_HEADER_SERVER    = 0x01, // Server: s_server
+        STATIC_HEADER_KEEPALIVE = 0x02, // Connection: keep-alive
+        STATIC_HEADER_CLOSE     = 0x04, // Connection: close
+    };
+    static char s_server[64];
     http_status status_code;
+    unsigned    static_headers;
     const char* status_message() {
         return http_status_str(status_code);
     }
@@ -501,6 +521,7 @@ public:
 
     void Init() {
         status_code = HTTP_STATUS_OK;
+        static_headers = 0;
     }
 
     virtual void Reset() {
@@ -508,7 +529,18 @@ public:
         Init();
     }
 
+    bool IsKeepAlive() {
+        if ((static_headers & (STATIC_HEADER_KEEPALIVE | STATIC_HEADER_CLOSE)) &&
+            headers.find("Connection") == headers.end()) {
+            return static_headers & STATIC_HEADER_KEEPALIVE;
+        }
+        return HttpMessage::IsKeepAlive();
+    }
+
     virtual std::string Dump(bool is_dump_headers = true, bool is_dump_body = false);
+    // NOTE: dump into str to reuse its capacity,
+    // sized by a first pass over headers, without inserting into headers.
+    void Dump(std::string& str, bool is_dump_headers = true, bool is_dump_body = false);
 
     // Content-Range: bytes 0-4095/10240000
     void SetRange(long from, long to, long total) {
@@ -7,12 +7,16 @@
 
 #include "wsdef.h"
 #include "hmath.h"
+#include "hthread.h"
+#include "WebSocketDeflate.h"
 
 namespace hv {
 
 class WebSocketChannel : public SocketChannel {
 public:
     ws_session_type type;
+    // permessage-deflate if negotiated
+    WebSocketDeflatePtr deflate;
     WebSocketChannel(hio_t* io, ws_session_type type = WS_CLIENT)
         : SocketChannel(io)
         , type(type)
@@ -20,6 +24,8 @@ public:
     ~WebSocketChannel() {}
 
     // isConnected, send, close
+    // NOTE: with ENABLE_LOCKFREE_WRITE, send and sendFrame in the loop thread only,
+    // as hio_write, see hevent.h.
 
     int send(const std::string& msg, enum ws_opcode opcode = WS_OPCODE_TEXT, bool fin = true) {
         return send(msg.c_str(), msg.size(), opcode, fin);
@@ -27,7 +33,7 @@ public:
 
     int send(const char* buf, int len, enum ws_opcode opcode = WS_OPCODE_BINARY, bool fin = true) {
         int fragment = 0xFFFF; // 65535
-        if (len > fragment) {
+        if (len > fragment || (fin && compressible(len, opcode))) {
             return send(buf, len, fragment, opcode);
         }
         return send_(buf, len, opcode, fin);
@@ -39,12 +45,60 @@ public:
     // ... ->
     // send(p, remain, WS_OPCODE_CONTINUE, true)
     int send(const char* buf, int len, int fragment, enum ws_opcode opcode = WS_OPCODE_BINARY) {
+        // NOTE: locked until all fragments sent, frames of other messages
+        // must not be interleaved (RFC 6455 5.4), and messages are sent
+        // in the order of compression.
+        std::lock_guard<std::recursive_mutex> locker(mutex_);
+        if (compressible(len, opcode)) {
+            compressbuf_.clear();
+            if (deflate->Compress(buf, len, compressbuf_) < 0) {
+                return -1;
+            }
+            int nsend = sendFragments(compressbuf_.data(), compressbuf_.size(), fragment, opcode, true);
+            return nsend < 0 ? nsend : len;
+        }
+        return sendFragments(buf, len, fragment, opcode);
+    }
+
+    // server frame encoded once, shared by channels to broadcast
+    static BufferPtr buildServerFrame(const char* buf, int len, enum ws_opcode opcode = WS_OPCODE_BINARY, bool fin = true) {
+        char mask[4] = {0};
+        BufferPtr frame(new Buffer(ws_calc_frame_size(len, false)));
+        ws_build_frame(frame->base, buf, len, mask, false, opcode, fin);
+        return frame;
+    }
+
+    int sendFrame(const BufferPtr& frame) {
+        return writeMessage(frame->base, frame->len);
+    }
+
+    // NOTE: not between fragments of a message sent by other threads
+    virtual int writeMessage(const void* data, int size) {
+        std::lock_guard<std::recursive_mutex> locker(mutex_);
+        return write(data, size);
+    }
+
+    // close frame with status code, see enum ws_close_code
+    int sendClose(int code = WS_CLOSE_NORMAL) {
+        char payload[2];
+        payload[0] = (code >> 8) & 0xFF;
+        payload[1] = code & 0xFF;
+        return send_(payload, 2, WS_OPCODE_CLOSE, true);
+    }
+
+protected:
+    bool compressible(int len, enum ws_opcode opcode) {
+        return deflate && len >= deflate->options.min_compress_size &&
+               (opcode == WS_OPCODE_TEXT || opcode == WS_OPCODE_BINARY);
+    }
+
+    int sendFragments(const char* buf, int len, int fragment, enum ws_opcode opcode, bool compressed = false) {
         if (len <= fragment) {
-            return send_(buf, len, opcode, true);
+            return send_(buf, len, opcode, true, compressed);
         }
 
         // first fragment
-        int nsend = send_(buf, fragment, opcode, false);
+        int nsend = send_(buf, fragment, opcode, false, compressed);
         if (nsend < 0) return nsend;
 
         const char* p = buf + fragment;
@@ -63,26 +117,42 @@ public:
         return len;
     }
 
-protected:
-    int send_(const char* buf, int len, enum ws_opcode opcode = WS_OPCODE_BINARY, bool fin = true) {
-        bool has_mask = false;
-        char mask[4] = {0};
+    // @param compressed: RSV1 set on the first frame of a compressed message
+    int send_(const char* buf, int len, enum ws_opcode opcode = WS_OPCODE_BINARY, bool fin = true, bool compressed = false) {
+#ifdef ENABLE_LOCKFREE_WRITE
+        assert(hv_gettid() == hloop_tid(hevent_loop(io_)));
+#endif
         if (type == WS_CLIENT) {
-            has_mask = true;
+            // NOTE: client must mask payload, so it is copied into sendbuf_
+            char mask[4];
             *(int*)mask = rand();
+            int frame_size = ws_calc_frame_size(len, true);
+            std::lock_guard<std::recursive_mutex> locker(mutex_);
+            if (sendbuf_.len < frame_size) {
+                sendbuf_.resize(ceil2e(frame_size));
+            }
+            ws_build_frame(sendbuf_.base, buf, len, mask, true, opcode, fin);
+            if (compressed) {
+                sendbuf_.base[0] |= WS_FRAME_RSV1;
+            }
+            return write(sendbuf_.base, frame_size);
         }
-        int frame_size = ws_calc_frame_size(len, has_mask);
-        std::lock_guard<std::mutex> locker(mutex_);
-        if (sendbuf_.len < frame_size) {
-            sendbuf_.resize(ceil2e(frame_size));
-        }
-        ws_build_frame(sendbuf_.base, buf, len, mask, has_mask, opcode, fin);
-        return write(sendbuf_.base, frame_size);
+        // header + payload by writev, payload not copied unless partly written
+        char header[WS_MAX_FRAME_HEADER_SIZE];
+        hbuf_t bufs[2];
+        bufs[0].base = header;
+        bufs[0].len = ws_build_frame_header(header, len, NULL, false, opcode, fin, compressed);
+        bufs[1].base = (char*)buf;
+        bufs[1].len = len;
+        // NOTE: lock, not between fragments of a message sent by other threads
+        std::lock_guard<std::recursive_mutex> locker(mutex_);
+        return writev(bufs, len == 0 ? 1 : 2);
     }
 
 private:
-    Buffer      sendbuf_;
-    std::mutex  mutex_;
+    Buffer                  sendbuf_;
+    std::string             compressbuf_;
+    std::recursive_mutex    mutex_;
 };
 
 }
@@ -0,0 +1,281 @@
+#include "WebSocketDeflate.h"
+
+#include "hdef.h"
+#include "hbase.h"
+#include "hlog.h"
+#include "hstring.h"
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#define WS_DEFLATE_TAIL         "\x00\x00\xff\xff"
+#define WS_DEFLATE_TAIL_LEN     4
+#define WS_DEFLATE_CHUNK_SIZE   4096
+// NOTE: zlib raw deflate does not support window bits 8
+#define WS_MIN_WINDOW_BITS      9
+#define WS_MAX_WINDOW_BITS      15
+
+// extension parameters, 0 if absent
+struct ws_deflate_params {
+    bool    server_no_context_takeover;
+    bool    client_no_context_takeover;
+    int     server_max_window_bits;
+    // -1 if without value
+    int     client_max_window_bits;
+};
+
+// permessage-deflate; name[=value]; ...
+// @retval -1 if not permessage-deflate or invalid parameters
+static int parse_deflate_params(const std::string& extension, ws_deflate_params* params) {
+    memset(params, 0, sizeof(ws_deflate_params));
+    hv::StringList strs = hv::split(extension, ';');
+    if (strs.empty() || stricmp(hv::trim(strs[0]).c_str(), WS_PERMESSAGE_DEFLATE) != 0) {
+        return -1;
+    }
+    for (size_t i = 1; i < strs.size(); ++i) {
+        std::string name, value;
+        size_t pos = strs[i].find('=');
+        if (pos == std::string::npos) {
+            name = hv::trim(strs[i]);
+        } else {
+            name = hv::trim(strs[i].substr(0, pos));
+            value = hv::trim_pairs(hv::trim(strs[i].substr(pos + 1)), "\"\"");
+        }
+        int bits = -1;
+        if (!value.empty()) {
+            bits = atoi(value.c_str());
+            if (bits < 8 || bits > WS_MAX_WINDOW_BITS) return -1;
+        }
+        if (name == "server_no_context_takeover" && value.empty() && !params->server_no_context_takeover) {
+            params->server_no_context_takeover = true;
+        }
+        else if (name == "client_no_context_takeover" && value.empty() && !params->client_no_context_takeover) {
+            params->client_no_context_takeover = true;
+        }
+        else if (name == "server_max_window_bits" && bits > 0 && params->server_max_window_bits == 0) {
+            params->server_max_window_bits = bits;
+        }
+        else if (name == "client_max_window_bits" && params->client_max_window_bits == 0) {
+            params->client_max_window_bits = bits;
+        }
+        else {
+            // unknown or duplicated
+            return -1;
+        }
+    }
+    return 0;
+}
+
+WebSocketDeflate::WebSocketDeflate(ws_session_type type, const WebSocketDeflateOptions& options)
+    : type(type)
+    , options(options)
+    , deflate_(NULL)
+    , inflate_(NULL)
+{
+    this->options.server_max_window_bits = LIMIT(WS_MIN_WINDOW_BITS, options.server_max_window_bits, WS_MAX_WINDOW_BITS);
+    this->options.client_max_window_bits = LIMIT(WS_MIN_WINDOW_BITS, options.client_max_window_bits, WS_MAX_WINDOW_BITS);
+    this->options.mem_level = LIMIT(1, options.mem_level, 9);
+}
+
+WebSocketDeflate::~WebSocketDeflate() {
+#ifdef WITH_ZLIB
+    if (deflate_) {
+        deflateEnd(deflate_);
+        HV_FREE(deflate_);
+    }
+    if (inflate_) {
+        inflateEnd(inflate_);
+        HV_FREE(inflate_);
+    }
+#endif
+}
+
+bool WebSocketDeflate::IsSupported() {
+#ifdef WITH_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string WebSocketDeflate::Offer(const WebSocketDeflateOptions& options) {
+    std::string offer(WS_PERMESSAGE_DEFLATE);
+    if (options.server_no_context_takeover) {
+        offer += "; server_no_context_takeover";
+    }
+    if (options.client_no_context_takeover) {
+        offer += "; client_no_context_takeover";
+    }
+    if (options.server_max_window_bits < WS_MAX_WINDOW_BITS) {
+        offer += "; server_max_window_bits=";
+        offer += hv::to_string(MAX(options.server_max_window_bits, WS_MIN_WINDOW_BITS));
+    }
+    // NOTE: tells server that client supports the parameter
+    offer += "; client_max_window_bits";
+    if (options.client_max_window_bits < WS_MAX_WINDOW_BITS) {
+        offer += "=";
+        offer += hv::to_string(MAX(options.client_max_window_bits, WS_MIN_WINDOW_BITS));
+    }
+    return offer;
+}
+
+int WebSocketDeflate::Confirm(const char* response) {
+    if (!IsSupported() || response == NULL) return -1;
+    hv::StringList extensions = hv::split(response, ',');
+    ws_deflate_params params;
+    if (extensions.size() != 1 || parse_deflate_params(extensions[0], &params) != 0) {
+        return -1;
+    }
+    // NOTE: server must not use a larger window than offered
+    if (params.server_max_window_bits > options.server_max_window_bits) {
+        return -1;
+    }
+    if (params.client_max_window_bits > 0) {
+        if (params.client_max_window_bits < WS_MIN_WINDOW_BITS) return -1;
+        options.client_max_window_bits = MIN(options.client_max_window_bits, params.client_max_window_bits);
+    }
+    options.server_no_context_takeover |= params.server_no_context_takeover;
+    options.client_no_context_takeover |= params.client_no_context_takeover;
+    return 0;
+}
+
+int WebSocketDeflate::Negotiate(const char* offers, std::string& response) {
+    if (!IsSupported() || offers == NULL) return -1;
+    hv::StringList extensions = hv::split(offers, ',');
+    for (auto& extension : extensions) {
+        ws_deflate_params params;
+        if (parse_deflate_params(extension, &params) != 0) continue;
+        if (params.server_max_window_bits > 0 && params.server_max_window_bits < WS_MIN_WINDOW_BITS) continue;
+
+        WebSocketDeflateOptions negotiated = options;
+        negotiated.server_no_context_takeover |= params.server_no_context_takeover;
+        negotiated.client_no_context_takeover |= params.client_no_context_takeover;
+        if (params.server_max_window_bits > 0) {
+            negotiated.server_max_window_bits = MIN(options.server_max_window_bits, params.server_max_window_bits);
+        }
+        if (params.client_max_window_bits > 0) {
+            negotiated.client_max_window_bits = MIN(options.client_max_window_bits, params.client_max_window_bits);
+        } else if (params.client_max_window_bits == 0) {
+            // NOTE: client not support the parameter, so its window is not limited
+            negotiated.client_max_window_bits = WS_MAX_WINDOW_BITS;
+        }
+
+        response = WS_PERMESSAGE_DEFLATE;
+        if (negotiated.server_no_context_takeover) {
+            response += "; server_no_context_takeover";
+        }
+        if (negotiated.client_no_context_takeover) {
+            response += "; client_no_context_takeover";
+        }
+        if (negotiated.server_max_window_bits < WS_MAX_WINDOW_BITS) {
+            response += "; server_max_window_bits=";
+            response += hv::to_string(negotiated.server_max_window_bits);
+        }
+        if (params.client_max_window_bits != 0 && negotiated.client_max_window_bits < WS_MAX_WINDOW_BITS) {
+            response += "; client_max_window_bits=";
+            response += hv::to_string(negotiated.client_max_window_bits);
+        }
+        options = negotiated;
+        return 0;
+    }
+    return -1;
+}
+
+int WebSocketDeflate::Compress(const char* data, size_t len, std::string& out) {
+#ifdef WITH_ZLIB
+    bool no_context_takeover = type == WS_SERVER ? options.server_no_context_takeover : options.client_no_context_takeover;
+    if (deflate_ == NULL) {
+        int window_bits = type == WS_SERVER ? options.server_max_window_bits : options.client_max_window_bits;
+        HV_ALLOC_SIZEOF(deflate_);
+        if (deflateInit2(deflate_, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                -window_bits, options.mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+            HV_FREE(deflate_);
+            return -1;
+        }
+    }
+    size_t offset = out.size();
+    deflate_->next_in = (Bytef*)data;
+    deflate_->avail_in = len;
+    do {
+        size_t size = out.size();
+        out.resize(size + MAX(len / 2, WS_DEFLATE_CHUNK_SIZE));
+        deflate_->next_out = (Bytef*)&out[size];
+        deflate_->avail_out = out.size() - size;
+        int ret = deflate(deflate_, Z_SYNC_FLUSH);
+        out.resize(out.size() - deflate_->avail_out);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            hloge("deflate error: %d", ret);
+            deflateReset(deflate_);
+            return -1;
+        }
+    } while (deflate_->avail_out == 0);
+    // NOTE: remove tail of sync flush
+    if (out.size() - offset >= WS_DEFLATE_TAIL_LEN &&
+        memcmp(out.data() + out.size() - WS_DEFLATE_TAIL_LEN, WS_DEFLATE_TAIL, WS_DEFLATE_TAIL_LEN) == 0) {
+        out.resize(out.size() - WS_DEFLATE_TAIL_LEN);
+    }
+    if (no_context_takeover) {
+        deflateReset(deflate_);
+    }
+    return out.size() - offset;
+#else
+    return -1;
+#endif
+}
+
+int WebSocketDeflate::Decompress(const char* data, size_t len, std::string& out, size_t max_size) {
+#ifdef WITH_ZLIB
+    bool no_context_takeover = type == WS_SERVER ? options.client_no_context_takeover : options.server_no_context_takeover;
+    if (inflate_ == NULL) {
+        // NOTE: a larger window inflates any smaller one
+        int window_bits = type == WS_SERVER ? options.client_max_window_bits : options.server_max_window_bits;
+        HV_ALLOC_SIZEOF(inflate_);
+        if (inflateInit2(inflate_, -window_bits) != Z_OK) {
+            HV_FREE(inflate_);
+            return -1;
+        }
+    }
+    size_t offset = out.size();
+    const char* inputs[2] = { data, WS_DEFLATE_TAIL };
+    size_t input_lens[2] = { len, WS_DEFLATE_TAIL_LEN };
+    for (int i = 0; i < 2; ++i) {
+        inflate_->next_in = (Bytef*)inputs[i];
+        inflate_->avail_in = input_lens[i];
+        // NOTE: go on while output is full, zlib may have more pending
+        do {
+            size_t size = out.size();
+            if (size - offset >= max_size) {
+                hloge("inflated message over %u", (unsigned int)max_size);
+                inflateReset(inflate_);
+                return -1;
+            }
+            out.resize(size + MIN(MAX(len * 2, WS_DEFLATE_CHUNK_SIZE), max_size - (size - offset)));
+            inflate_->next_out = (Bytef*)&out[size];
+            inflate_->avail_out = out.size() - size;
+            int ret = inflate(inflate_, Z_SYNC_FLUSH);
+            out.resize(out.size() - inflate_->avail_out);
+            if (ret == Z_STREAM_END) {
+                // final block, the rest is ignored
+                inflateReset(inflate_);
+                return out.size() - offset;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                hloge("inflate error: %d", ret);
+                inflateReset(inflate_);
+                return -1;
+            }
+            if (ret == Z_BUF_ERROR && inflate_->avail_out != 0) {
+                // no progress
+                break;
+            }
+        } while (inflate_->avail_in != 0 || inflate_->avail_out == 0);
+    }
+    if (no_context_takeover) {
+        inflateReset(inflate_);
+    }
+    return out.size() - offset;
+#else
+    return -1;
+#endif
+}
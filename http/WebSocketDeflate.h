@@ -0,0 +1,77 @@
+#ifndef HV_WEBSOCKET_DEFLATE_H_
+#define HV_WEBSOCKET_DEFLATE_H_
+
+/*
+ * permessage-deflate
+ * @see https://datatracker.ietf.org/doc/html/rfc7692
+ * NOTE: compiled with zlib only, see WITH_ZLIB
+ */
+
+#include "hexport.h"
+
+#include <string>
+#include <memory>
+
+#include "wsdef.h"
+
+#define WS_PERMESSAGE_DEFLATE   "permessage-deflate"
+
+struct HV_EXPORT WebSocketDeflateOptions {
+    // reset compression context after every message,
+    // saves memory between messages but compresses worse
+    bool    server_no_context_takeover;
+    bool    client_no_context_takeover;
+    // LZ77 window bits [9, 15]
+    int     server_max_window_bits;
+    int     client_max_window_bits;
+    // deflate memLevel [1, 9]
+    // NOTE: memory per connection is about
+    // deflate: (1 << (window_bits + 2)) + (1 << (mem_level + 9))
+    // inflate: (1 << window_bits) + 7K
+    int     mem_level;
+    // messages shorter than this are sent uncompressed
+    int     min_compress_size;
+
+    WebSocketDeflateOptions() {
+        server_no_context_takeover = false;
+        client_no_context_takeover = false;
+        server_max_window_bits = 15;
+        client_max_window_bits = 15;
+        mem_level = 8;
+        min_compress_size = 64;
+    }
+};
+
+struct z_stream_s;
+class HV_EXPORT WebSocketDeflate {
+public:
+    ws_session_type             type;
+    WebSocketDeflateOptions     options;    // negotiated
+
+    WebSocketDeflate(ws_session_type type, const WebSocketDeflateOptions& options = WebSocketDeflateOptions());
+    ~WebSocketDeflate();
+
+    static bool IsSupported();
+
+    // client: Sec-WebSocket-Extensions of request
+    static std::string Offer(const WebSocketDeflateOptions& options);
+    // client: @retval 0 if Sec-WebSocket-Extensions of response accepts the offer
+    int Confirm(const char* response);
+    // server: chooses the first acceptable offer in Sec-WebSocket-Extensions of request,
+    // @retval 0 and response is Sec-WebSocket-Extensions of response.
+    int Negotiate(const char* offers, std::string& response);
+
+    // one message, appended to out
+    int Compress(const char* data, size_t len, std::string& out);
+    // @retval -1 if corrupted or longer than max_size
+    int Decompress(const char* data, size_t len, std::string& out, size_t max_size);
+
+private:
+    // NOTE: streams are created on first use, idle connections cost no memory.
+    struct z_stream_s*  deflate_;
+    struct z_stream_s*  inflate_;
+};
+
+typedef std::shared_ptr<WebSocketDeflate> WebSocketDeflatePtr;
+
+#endif // HV_WEBSOCKET_DEFLATE_H_
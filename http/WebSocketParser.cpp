@@ -4,24 +4,53 @@
 #include "hdef.h"
 
 #define MAX_PAYLOAD_LENGTH  (1 << 24)   // 16M
+// NOTE: reserve no more than this by frame length, larger messages grow as data arrives
+#define MAX_RESERVE_LENGTH  (1 << 16)   // 64K
+
+#define IS_CONTROL_OPCODE(opcode)   ((opcode) & 0x8)
 
 static int on_frame_header(websocket_parser* parser) {
     WebSocketParser* wp = (WebSocketParser*)parser->data;
     int opcode = parser->flags & WS_OP_MASK;
     // printf("on_frame_header opcode=%d\n", opcode);
+    wp->state = WS_FRAME_HEADER;
+    bool rsv1 = parser->flags & WS_RSV1;
+    if (IS_CONTROL_OPCODE(opcode)) {
+        // NOTE: control frames may be injected in the middle of a fragmented message
+        if (rsv1 || parser->length > 125 || !(parser->flags & WS_FIN)) {
+            wp->close_code = WS_CLOSE_PROTOCOL_ERROR;
+            return -1;
+        }
+        wp->control.clear();
+        return 0;
+    }
     if (opcode != WS_OP_CONTINUE) {
+        // NOTE: RSV1 only allowed on the first frame of a message if permessage-deflate
+        if (rsv1 && wp->deflate == NULL) {
+            wp->close_code = WS_CLOSE_PROTOCOL_ERROR;
+            return -1;
+        }
         wp->opcode = opcode;
+        wp->compressed = rsv1;
+        wp->message_size = 0;
+        wp->message.clear();
+    } else if (rsv1) {
+        wp->close_code = WS_CLOSE_PROTOCOL_ERROR;
+        return -1;
+    }
+    wp->message_size += parser->length;
+    if (wp->max_message_size && wp->message_size > wp->max_message_size) {
+        wp->close_code = WS_CLOSE_MESSAGE_TOO_BIG;
+        return -1;
     }
-    int length = parser->length;
-    int reserve_length = MIN(length + 1, MAX_PAYLOAD_LENGTH);
+    if (wp->onFragment && !wp->compressed) {
+        // streaming, no buffer
+        return 0;
+    }
+    size_t reserve_length = wp->message.size() + MIN(parser->length, MAX_RESERVE_LENGTH);
     if (reserve_length > wp->message.capacity()) {
         wp->message.reserve(reserve_length);
     }
-    if (wp->state == WS_FRAME_BEGIN ||
-        wp->state == WS_FRAME_FIN) {
-        wp->message.clear();
-    }
-    wp->state = WS_FRAME_HEADER;
     return 0;
 }
 
@@ -32,7 +61,18 @@ static int on_frame_body(websocket_parser* parser, const char * at, size_t lengt
     if (wp->parser->flags & WS_HAS_MASK) {
         websocket_parser_decode((char*)at, at, length, wp->parser);
     }
-    wp->message.append(at, length);
+    int opcode = parser->flags & WS_OP_MASK;
+    if (IS_CONTROL_OPCODE(opcode)) {
+        wp->control.append(at, length);
+    }
+    else if (wp->onFragment && !wp->compressed) {
+        // NOTE: parser->require is the remain of frame including this piece
+        bool fin = (parser->flags & WS_FIN) && length == parser->require;
+        wp->onFragment(wp->opcode, at, length, fin);
+    }
+    else {
+        wp->message.append(at, length);
+    }
     return 0;
 }
 
@@ -40,12 +80,44 @@ static int on_frame_end(websocket_parser* parser) {
     // printf("on_frame_end\n");
     WebSocketParser* wp = (WebSocketParser*)parser->data;
     wp->state = WS_FRAME_END;
-    if (wp->parser->flags & WS_FIN) {
-        wp->state = WS_FRAME_FIN;
+    if (!(wp->parser->flags & WS_FIN)) {
+        return 0;
+    }
+    int opcode = parser->flags & WS_OP_MASK;
+    if (IS_CONTROL_OPCODE(opcode)) {
         if (wp->onMessage) {
-            wp->onMessage(wp->opcode, wp->message);
+            wp->onMessage(opcode, wp->control);
         }
+        return 0;
     }
+    wp->state = WS_FRAME_FIN;
+    if (wp->compressed) {
+        wp->compressed = false;
+        wp->inflated.clear();
+        size_t max_size = wp->max_message_size ? wp->max_message_size : MAX_PAYLOAD_LENGTH;
+        if (wp->deflate->Decompress(wp->message.data(), wp->message.size(), wp->inflated, max_size) < 0) {
+            wp->close_code = wp->inflated.size() >= max_size ? WS_CLOSE_MESSAGE_TOO_BIG : WS_CLOSE_INVALID_PAYLOAD;
+            return -1;
+        }
+        if (wp->onFragment) {
+            wp->onFragment(wp->opcode, wp->inflated.data(), wp->inflated.size(), true);
+        } else if (wp->onMessage) {
+            wp->onMessage(wp->opcode, wp->inflated);
+        }
+        wp->Shrink();
+        return 0;
+    }
+    if (wp->onFragment) {
+        // empty final frame, no body delivered
+        if (parser->length == 0) {
+            wp->onFragment(wp->opcode, "", 0, true);
+        }
+        return 0;
+    }
+    if (wp->onMessage) {
+        wp->onMessage(wp->opcode, wp->message);
+    }
+    wp->Shrink();
     return 0;
 }
 
@@ -60,6 +132,11 @@ WebSocketParser::WebSocketParser() {
     websocket_parser_init(parser);
     parser->data = this;
     state = WS_FRAME_BEGIN;
+    opcode = 0;
+    max_message_size = 0;
+    close_code = 0;
+    compressed = false;
+    message_size = 0;
 }
 
 WebSocketParser::~WebSocketParser() {
@@ -72,3 +149,13 @@ WebSocketParser::~WebSocketParser() {
 int WebSocketParser::FeedRecvData(const char* data, size_t len) {
     return websocket_parser_execute(parser, &cbs, data, len);
 }
+
+void WebSocketParser::Shrink() {
+    // NOTE: not to hold memory of a large message per connection
+    if (message.capacity() > MAX_RESERVE_LENGTH) {
+        std::string().swap(message);
+    }
+    if (inflated.capacity() > MAX_RESERVE_LENGTH) {
+        std::string().swap(inflated);
+    }
+}
@@ -7,6 +7,8 @@
 #include <memory>
 #include <functional>
 
+#include "WebSocketDeflate.h"
+
 enum websocket_parser_state {
     WS_FRAME_BEGIN,
     WS_FRAME_HEADER,
@@ -24,12 +26,28 @@ public:
     websocket_parser_state              state;
     int                                 opcode;
     std::string                         message;
+    std::string                         control;    // payload of control frame
+    // 0: unlimited, else close with WS_CLOSE_MESSAGE_TOO_BIG if exceeded
+    size_t                              max_message_size;
+    // set if FeedRecvData failed, to send a close frame
+    int                                 close_code;
+    // permessage-deflate if negotiated
+    WebSocketDeflatePtr                 deflate;
+    bool                                compressed;
+    std::string                         inflated;
+    size_t                              message_size;
     std::function<void(int opcode, const std::string& msg)> onMessage;
+    // Streaming mode: if set, payload of text/binary messages is delivered
+    // as it arrives instead of onMessage, fin is true on the last piece.
+    // NOTE: compressed messages are delivered inflated at once.
+    std::function<void(int opcode, const char* data, size_t size, bool fin)> onFragment;
 
     WebSocketParser();
     ~WebSocketParser();
 
     int FeedRecvData(const char* data, size_t len);
+    // release buffers of a large message after delivered
+    void Shrink();
 };
 
 typedef std::shared_ptr<WebSocketParser> WebSocketParserPtr;
@@ -13,6 +13,8 @@ WebSocketClient::WebSocketClient()
     state = WS_CLOSED;
     ping_interval = DEFAULT_WS_PING_INTERVAL;
     ping_cnt = 0;
+    max_message_size = 0;
+    permessage_deflate = false;
 }
 
 WebSocketClient::~WebSocketClient() {
@@ -78,6 +80,9 @@ int WebSocketClient::open(const char* _url, const http_headers& headers) {
             if (http_req_->GetHeader(SEC_WEBSOCKET_VERSION).empty()) {
                 http_req_->headers[SEC_WEBSOCKET_VERSION] = "13";
             }
+            if (permessage_deflate && WebSocketDeflate::IsSupported()) {
+                http_req_->headers[SEC_WEBSOCKET_EXTENSIONS] = WebSocketDeflate::Offer(deflate_options);
+            }
             std::string http_msg = http_req_->Dump(true, true);
             // printf("%s", http_msg.c_str());
             // NOTE: not use WebSocketChannel::send
@@ -120,6 +125,19 @@ int WebSocketClient::open(const char* _url, const http_headers& headers) {
                     return;
                 }
                 ws_parser_.reset(new WebSocketParser);
+                ws_parser_->max_message_size = max_message_size;
+                // permessage-deflate
+                std::string extensions = http_resp_->GetHeader(SEC_WEBSOCKET_EXTENSIONS);
+                if (!extensions.empty() && permessage_deflate && WebSocketDeflate::IsSupported()) {
+                    WebSocketDeflatePtr deflate(new WebSocketDeflate(WS_CLIENT, deflate_options));
+                    if (deflate->Confirm(extensions.c_str()) != 0) {
+                        hloge("Sec-WebSocket-Extensions not match: %s", extensions.c_str());
+                        channel->close();
+                        return;
+                    }
+                    ws_parser_->deflate = deflate;
+                    channel->deflate = deflate;
+                }
                 // websocket_onmessage
                 ws_parser_->onMessage = [this, &channel](int opcode, const std::string& msg) {
                     switch (opcode) {
@@ -145,6 +163,11 @@ int WebSocketClient::open(const char* _url, const http_headers& headers) {
                         break;
                     }
                 };
+                if (onfragment) {
+                    ws_parser_->onFragment = [this](int opcode, const char* data, size_t size, bool fin) {
+                        onfragment(data, size, fin);
+                    };
+                }
                 state = WS_OPENED;
                 // ping
                 if (ping_interval > 0) {
@@ -167,7 +190,10 @@ int WebSocketClient::open(const char* _url, const http_headers& headers) {
         if (state == WS_OPENED && size != 0) {
             int nparse = ws_parser_->FeedRecvData(data, size);
             if (nparse != size) {
-                hloge("websocket parse error!");
+                hloge("websocket parse error: %d", ws_parser_->close_code);
+                if (ws_parser_->close_code) {
+                    channel->sendClose(ws_parser_->close_code);
+                }
                 channel->close();
                 return;
             }
@@ -21,6 +21,9 @@ public:
     std::function<void()> onopen;
     std::function<void()> onclose;
     std::function<void(const std::string& msg)> onmessage;
+    // Streaming mode: if set, text/binary payload is delivered as it arrives
+    // instead of onmessage, fin is true on the last piece of a message.
+    std::function<void(const char* data, size_t size, bool fin)> onfragment;
 
     WebSocketClient();
     ~WebSocketClient();
@@ -37,6 +40,17 @@ public:
         ping_interval = ms;
     }
 
+    // close with 1009 if a message is longer than this, 0 means unlimited
+    void setMaxMessageSize(size_t size) {
+        max_message_size = size;
+    }
+
+    // permessage-deflate, compiled WITH_ZLIB only
+    void setPermessageDeflate(bool on, const WebSocketDeflateOptions& options = WebSocketDeflateOptions()) {
+        permessage_deflate = on;
+        deflate_options = options;
+    }
+
 private:
     enum State {
         CONNECTING,
@@ -52,6 +66,10 @@ private:
     // ping/pong
     int                 ping_interval;
     int                 ping_cnt;
+    size_t              max_message_size;
+    // permessage-deflate
+    bool                    permessage_deflate;
+    WebSocketDeflateOptions deflate_options;
 };
 
 }
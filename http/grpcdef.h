@@ -5,10 +5,33 @@
 extern "C" {
 #endif
 
+// https://github.com/grpc/grpc/blob/master/doc/statuscodes.md
+typedef enum {
+    GRPC_STATUS_OK                  = 0,
+    GRPC_STATUS_CANCELLED           = 1,
+    GRPC_STATUS_UNKNOWN             = 2,
+    GRPC_STATUS_INVALID_ARGUMENT    = 3,
+    GRPC_STATUS_DEADLINE_EXCEEDED   = 4,
+    GRPC_STATUS_NOT_FOUND           = 5,
+    GRPC_STATUS_ALREADY_EXISTS      = 6,
+    GRPC_STATUS_PERMISSION_DENIED   = 7,
+    GRPC_STATUS_RESOURCE_EXHAUSTED  = 8,
+    GRPC_STATUS_FAILED_PRECONDITION = 9,
+    GRPC_STATUS_ABORTED             = 10,
+    GRPC_STATUS_OUT_OF_RANGE        = 11,
+    GRPC_STATUS_UNIMPLEMENTED       = 12,
+    GRPC_STATUS_INTERNAL            = 13,
+    GRPC_STATUS_UNAVAILABLE         = 14,
+    GRPC_STATUS_DATA_LOSS           = 15,
+    GRPC_STATUS_UNAUTHENTICATED     = 16,
+} grpc_status;
+
 // Length-Prefixed-Message
 
 // flags:1byte + length:4bytes = 5bytes
 #define GRPC_MESSAGE_HDLEN  5
+// flags
+#define GRPC_MESSAGE_FLAG_COMPRESSED    0x01
 
 typedef struct {
     unsigned char   flags;
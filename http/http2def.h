@@ -12,6 +12,10 @@ extern "C" {
 // length:3bytes + type:1byte + flags:1byte + stream_id:4bytes = 9bytes
 #define HTTP2_FRAME_HDLEN       9
 
+#define DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS    100
+// the default of RFC 7540
+#define DEFAULT_HTTP2_INITIAL_WINDOW_SIZE       65535
+
 #define HTTP2_UPGRADE_RESPONSE \
 "HTTP/1.1 101 Switching Protocols\r\n"\
 "Connection: Upgrade\r\n"\
@@ -4,6 +4,10 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace hv;
 
 std::string dump_query_params(const QueryParams& query_params) {
@@ -19,6 +23,33 @@ std::string dump_query_params(const QueryParams& query_params) {
     return query_string;
 }
 
+void dump_sse_event(std::string& str, const char* data, size_t len, const char* event, const char* id) {
+    if (id) {
+        str += "id: ";
+        str += id;
+        str += '\n';
+    }
+    if (event) {
+        str += "event: ";
+        str += event;
+        str += '\n';
+    }
+    // NOTE: one data field per line, CRLF or LF
+    const char* p = data;
+    const char* end = data + len;
+    do {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        const char* next = eol ? eol + 1 : end;
+        if (eol && eol > p && *(eol - 1) == '\r') --eol;
+        if (eol == NULL) eol = end;
+        str += "data: ";
+        str.append(p, eol - p);
+        str += '\n';
+        p = next;
+    } while (p < end);
+    str += '\n';
+}
+
 int parse_query_params(const char* query_string, QueryParams& query_params) {
     const char* p = strchr(query_string, '?');
     p = p ? p+1 : query_string;
@@ -120,6 +151,8 @@ enum multipart_parser_state_e {
 };
 struct multipart_parser_userdata {
     MultiPart* mp;
+    // NOTE: not NULL if streaming
+    MultipartStreamParser* stream;
     // tmp
     multipart_parser_state_e state;
     std::string header_field;
@@ -182,6 +215,12 @@ static int on_part_data(multipart_parser* parser, const char *at, size_t length)
     //printf("on_part_data:%.*s\n", (int)length, at);
     multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
     userdata->state = MP_PART_DATA;
+    if (userdata->stream) {
+        if (userdata->stream->onPartData) {
+            userdata->stream->onPartData(at, length);
+        }
+        return 0;
+    }
     userdata->part_data.append(at, length);
     return 0;
 }
@@ -196,12 +235,23 @@ static int on_headers_complete(multipart_parser* parser) {
     multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
     userdata->handle_header();
     userdata->state = MP_HEADERS_COMPLETE;
+    if (userdata->stream && userdata->stream->onPartBegin) {
+        userdata->stream->onPartBegin(userdata->name, userdata->filename);
+    }
     return 0;
 }
 static int on_part_data_end(multipart_parser* parser) {
     //printf("on_part_data_end\n");
     multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
     userdata->state = MP_PART_DATA_END;
+    if (userdata->stream) {
+        if (userdata->stream->onPartEnd) {
+            userdata->stream->onPartEnd();
+        }
+        userdata->name.clear();
+        userdata->filename.clear();
+        return 0;
+    }
     userdata->handle_data();
     return 0;
 }
@@ -211,10 +261,7 @@ static int on_body_end(multipart_parser* parser) {
     userdata->state = MP_BODY_END;
     return 0;
 }
-int parse_multipart(const std::string& str, MultiPart& mp, const char* boundary) {
-    //printf("boundary=%s\n", boundary);
-    std::string __boundary("--");
-    __boundary += boundary;
+static multipart_parser_settings multipart_parser_settings_init() {
     multipart_parser_settings settings;
     settings.on_header_field = on_header_field;
     settings.on_header_value = on_header_value;
@@ -223,16 +270,54 @@ int parse_multipart(const std::string& str, MultiPart& mp, const char* boundary)
     settings.on_headers_complete = on_headers_complete;
     settings.on_part_data_end    = on_part_data_end;
     settings.on_body_end         = on_body_end;
-    multipart_parser* parser = multipart_parser_init(__boundary.c_str(), &settings);
+    return settings;
+}
+
+static multipart_parser* multipart_parser_new(const char* boundary) {
+    // NOTE: parser keeps the pointer of settings
+    static multipart_parser_settings s_settings = multipart_parser_settings_init();
+    std::string __boundary("--");
+    __boundary += boundary;
+    return multipart_parser_init(__boundary.c_str(), &s_settings);
+}
+
+int parse_multipart(const std::string& str, MultiPart& mp, const char* boundary) {
+    //printf("boundary=%s\n", boundary);
+    multipart_parser* parser = multipart_parser_new(boundary);
     multipart_parser_userdata userdata;
     userdata.state = MP_START;
     userdata.mp = &mp;
+    userdata.stream = NULL;
     multipart_parser_set_data(parser, &userdata);
     size_t nparse = multipart_parser_execute(parser, str.c_str(), str.size());
     multipart_parser_free(parser);
     return nparse == str.size() ? 0 : -1;
 }
 
+MultipartStreamParser::MultipartStreamParser(const char* boundary) {
+    parser = multipart_parser_new(boundary);
+    multipart_parser_userdata* ud = new multipart_parser_userdata;
+    ud->state = MP_START;
+    ud->mp = NULL;
+    ud->stream = this;
+    multipart_parser_set_data(parser, ud);
+    userdata = ud;
+}
+
+MultipartStreamParser::~MultipartStreamParser() {
+    multipart_parser_free(parser);
+    delete (multipart_parser_userdata*)userdata;
+}
+
+int MultipartStreamParser::FeedRecvData(const char* data, size_t size) {
+    size_t nparse = multipart_parser_execute(parser, data, size);
+    return nparse == size ? 0 : -1;
+}
+
+bool MultipartStreamParser::IsComplete() {
+    return ((multipart_parser_userdata*)userdata)->state == MP_BODY_END;
+}
+
 std::string dump_json(const hv::Json& json, int indent) {
     return json.dump(indent);
 }
@@ -247,4 +332,152 @@ int parse_json(const char* str, hv::Json& json, std::string& errmsg) {
     }
     return (json.is_discarded() || json.is_null()) ? -1 : 0;
 }
+
+void dump_json(const hv::Json& json, std::string& str, int indent) {
+    str += json.dump(indent);
+}
+
+static inline const char* json_skip_ws(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+    return p;
+}
+
+// @param p: after the opening quote
+// @retval after the closing quote, NULL if unterminated
+static const char* json_skip_string(const char* p, const char* end) {
+#if defined(__SSE2__) && defined(__GNUC__)
+    // 16 bytes a time to the next quote or backslash
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    while (p + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+                    _mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+        if (mask == 0) {
+            p += 16;
+            continue;
+        }
+        p += __builtin_ctz(mask);
+        if (*p == '"') return p + 1;
+        // skip escaped char
+        p += 2;
+    }
+#endif
+    while (p < end) {
+        if (*p == '"') return p + 1;
+        p += *p == '\\' ? 2 : 1;
+    }
+    return NULL;
+}
+
+// @param p: at the opening bracket
+// @retval after the matching closing bracket, NULL if unterminated
+static const char* json_skip_container(const char* p, const char* end) {
+    int depth = 0;
+#if defined(__SSE2__) && defined(__GNUC__)
+    // 16 bytes a time to the next structural char: " [ ] { }
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bracket = _mm_set1_epi8('[');
+    const __m128i brace = _mm_set1_epi8('{');
+    // NOTE: ']' '}' are '[' '{' + 2
+    const __m128i two = _mm_set1_epi8(2);
+    while (p + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i open = _mm_or_si128(_mm_cmpeq_epi8(v, bracket), _mm_cmpeq_epi8(v, brace));
+        __m128i v2 = _mm_sub_epi8(v, two);
+        __m128i close = _mm_or_si128(_mm_cmpeq_epi8(v2, bracket), _mm_cmpeq_epi8(v2, brace));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                  _mm_or_si128(open, close)));
+        while (mask) {
+            const char* q = p + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (*q == '"') {
+                // string may end in another block, rescan from there
+                p = json_skip_string(q + 1, end);
+                if (p == NULL) return NULL;
+                goto next_block;
+            }
+            if (*q == '[' || *q == '{') {
+                ++depth;
+            } else if (--depth == 0) {
+                return q + 1;
+            }
+        }
+        p += 16;
+next_block:
+        ;
+    }
+#endif
+    while (p < end) {
+        switch (*p) {
+        case '"':
+            p = json_skip_string(p + 1, end);
+            if (p == NULL) return NULL;
+            continue;
+        case '[':
+        case '{':
+            ++depth;
+            break;
+        case ']':
+        case '}':
+            if (--depth == 0) return p + 1;
+            break;
+        default:
+            break;
+        }
+        ++p;
+    }
+    return NULL;
+}
+
+// @retval after the value, NULL if unterminated
+static const char* json_skip_value(const char* p, const char* end) {
+    if (p >= end) return NULL;
+    switch (*p) {
+    case '"':
+        return json_skip_string(p + 1, end);
+    case '[':
+    case '{':
+        return json_skip_container(p, end);
+    default:
+        // number, true, false, null
+        while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+               *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') ++p;
+        return p;
+    }
+}
+
+bool find_json_field(const char* str, size_t len, const char* key,
+                     const char** value, size_t* value_len) {
+    const char* p = str;
+    const char* end = str + len;
+    size_t keylen = strlen(key);
+    p = json_skip_ws(p, end);
+    if (p == end || *p != '{') return false;
+    ++p;
+    while (1) {
+        p = json_skip_ws(p, end);
+        if (p == end || *p != '"') return false;
+        const char* name = p + 1;
+        p = json_skip_string(name, end);
+        if (p == NULL) return false;
+        // NOTE: names with escapes are compared as they are
+        bool matched = (size_t)(p - 1 - name) == keylen && memcmp(name, key, keylen) == 0;
+        p = json_skip_ws(p, end);
+        if (p == end || *p != ':') return false;
+        p = json_skip_ws(p + 1, end);
+        const char* v = p;
+        p = json_skip_value(p, end);
+        if (p == NULL || p == v) return false;
+        if (matched) {
+            *value = v;
+            *value_len = p - v;
+            return true;
+        }
+        p = json_skip_ws(p, end);
+        if (p == end || *p != ',') return false;
+        ++p;
+    }
+    return false;
+}
 #endif
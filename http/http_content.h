@@ -1,6 +1,8 @@
 #ifndef HV_HTTP_CONTENT_H_
 #define HV_HTTP_CONTENT_H_
 
+#include <functional>
+
 #include "hexport.h"
 #include "hstring.h"
 
@@ -9,6 +11,11 @@ typedef hv::KeyValue    QueryParams;
 HV_EXPORT std::string dump_query_params(const QueryParams& query_params);
 HV_EXPORT int         parse_query_params(const char* query_string, QueryParams& query_params);
 
+// text/event-stream
+// id: <id>\nevent: <event>\ndata: <line>\n...\n\n, appended to str
+HV_EXPORT void        dump_sse_event(std::string& str, const char* data, size_t len,
+                                     const char* event = NULL, const char* id = NULL);
+
 // NOTE: WITHOUT_HTTP_CONTENT
 // ndk-r10e no std::to_string and can't compile modern json.hpp
 #ifndef WITHOUT_HTTP_CONTENT
@@ -59,6 +66,28 @@ typedef HV_MAP<std::string, FormData>          MultiPart;
 HV_EXPORT std::string dump_multipart(MultiPart& mp, const char* boundary = DEFAULT_MULTIPART_BOUNDARY);
 HV_EXPORT int         parse_multipart(const std::string& str, MultiPart& mp, const char* boundary);
 
+// streaming multipart/form-data, parts are not buffered.
+// onPartBegin -> onPartData -> onPartData ... -> onPartEnd
+struct multipart_parser;
+class HV_EXPORT MultipartStreamParser {
+public:
+    std::function<void(const std::string& name, const std::string& filename)>   onPartBegin;
+    std::function<void(const char* data, size_t size)>                          onPartData;
+    std::function<void()>                                                       onPartEnd;
+
+    MultipartStreamParser(const char* boundary);
+    ~MultipartStreamParser();
+
+    // @retval 0 OK, -1 parse error
+    int FeedRecvData(const char* data, size_t size);
+    // closing boundary received
+    bool IsComplete();
+
+private:
+    multipart_parser*   parser;
+    void*               userdata;
+};
+
 // Json
 // https://github.com/nlohmann/json
 #include "json.hpp"
@@ -69,6 +98,13 @@ using Json = nlohmann::json;
 
 HV_EXPORT std::string dump_json(const hv::Json& json, int indent = -1);
 HV_EXPORT int         parse_json(const char* str, hv::Json& json, std::string& errmsg);
+// appended to str, e.g. after headers, without a body string between
+HV_EXPORT void        dump_json(const hv::Json& json, std::string& str, int indent = -1);
+// Lazy reader: finds value of key in json object text without parsing all of it.
+// @retval true if found, *value points to raw json text of the value in str.
+// NOTE: not a validator, text after the value is not scanned.
+HV_EXPORT bool        find_json_field(const char* str, size_t len, const char* key,
+                                      const char** value, size_t* value_len);
 #endif
 
 #endif // HV_HTTP_CONTENT_H_
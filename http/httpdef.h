@@ -161,6 +161,7 @@ enum http_method {
     XX(APPLICATION_GRPC,        application/grpc,         grpc)         \
     XX(APPLICATION_URLENCODED,  application/x-www-form-urlencoded, kv)  \
     XX(MULTIPART_FORM_DATA,     multipart/form-data,               mp)  \
+    XX(TEXT_EVENT_STREAM,       text/event-stream,                 sse) \
 
 #define X_WWW_FORM_URLENCODED   APPLICATION_URLENCODED // for compatibility
 
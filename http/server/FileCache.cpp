@@ -17,7 +17,11 @@ file_cache_ptr FileCache::Open(const char* filepath, OpenParam* param) {
     if (fc) {
         time_t now = time(NULL);
         if (now - fc->stat_time > file_stat_interval) {
-            modified = fc->is_modified();
+            // NOTE: stat into a local, fc->st is read by loop threads without mutex_
+            struct stat st;
+            if (stat(filepath, &st) == 0) {
+                modified = st.st_mtime != fc->st.st_mtime || st.st_size != fc->st.st_size;
+            }
             fc->stat_time = now;
             fc->stat_cnt++;
         }
@@ -28,87 +32,188 @@ file_cache_ptr FileCache::Open(const char* filepath, OpenParam* param) {
         }
     }
     if (fc == NULL || modified || param->need_read) {
-        int flags = O_RDONLY;
+        // NOTE: load into a new file_cache_t, never change one handed out,
+        // loop threads may be sending its filebuf now without mutex_.
+        bool need_stat = fc == NULL || modified;
+        file_cache_ptr newfc(new file_cache_t);
+        if (!need_stat) {
+            // read the file of the cached stat, the old one keeps its fd
+            newfc->filepath = fc->filepath;
+            newfc->st = fc->st;
+            newfc->open_time = fc->open_time;
+            newfc->stat_time = fc->stat_time;
+            newfc->stat_cnt = fc->stat_cnt;
+        }
+        if (Load(filepath, newfc.get(), need_stat, param) != 0) {
+            return NULL;
+        }
+        cached_files[filepath] = newfc;
+        fc = newfc;
+    }
+    return fc;
+}
+
+int FileCache::Load(const char* filepath, file_cache_t* fc, bool need_stat, OpenParam* param) {
+    int flags = O_RDONLY;
 #ifdef O_BINARY
-        flags |= O_BINARY;
+    flags |= O_BINARY;
 #endif
-        int fd = open(filepath, flags);
-        if (fd < 0) {
+    int fd = open(filepath, flags);
+    if (fd < 0) {
 #ifdef OS_WIN
-            // NOTE: open(dir) return -1 on windows
-            if (!hv_isdir(filepath)) {
-                param->error = ERR_OPEN_FILE;
-                return NULL;
-            }
+        // NOTE: open(dir) return -1 on windows
+        if (!hv_isdir(filepath)) {
+            return param->error = ERR_OPEN_FILE;
+        }
 #else
-            param->error = ERR_OPEN_FILE;
-            return NULL;
+        return param->error = ERR_OPEN_FILE;
 #endif
+    }
+    defer(if (fd > 0) { close(fd); })
+    if (need_stat) {
+        struct stat st;
+        if (fd > 0) {
+            fstat(fd, &st);
+        } else {
+            stat(filepath, &st);
         }
-        defer(if (fd > 0) { close(fd); })
-        if (fc == NULL) {
-            struct stat st;
-            if (fd > 0) {
-                fstat(fd, &st);
-            } else {
-                stat(filepath, &st);
-            }
-            if (S_ISREG(st.st_mode) ||
-                (S_ISDIR(st.st_mode) &&
-                 filepath[strlen(filepath)-1] == '/')) {
-                fc.reset(new file_cache_t);
-                fc->filepath = filepath;
-                fc->st = st;
-                time(&fc->open_time);
-                fc->stat_time = fc->open_time;
-                fc->stat_cnt = 1;
-                cached_files[filepath] = fc;
-            }
-            else {
-                param->error = ERR_MISMATCH;
-                return NULL;
-            }
+        if (S_ISREG(st.st_mode) ||
+            (S_ISDIR(st.st_mode) &&
+             filepath[strlen(filepath)-1] == '/')) {
+            fc->filepath = filepath;
+            fc->st = st;
+            time(&fc->open_time);
+            fc->stat_time = fc->open_time;
+            fc->stat_cnt = 1;
         }
-        if (S_ISREG(fc->st.st_mode)) {
-            param->filesize = fc->st.st_size;
-            // FILE
-            if (param->need_read) {
-                if (fc->st.st_size > param->max_read) {
-                    param->error = ERR_OVER_LIMIT;
-                    return NULL;
-                }
+        else {
+            return param->error = ERR_MISMATCH;
+        }
+    }
+    if (S_ISREG(fc->st.st_mode)) {
+        param->filesize = fc->st.st_size;
+        // FILE
+        if (param->need_read) {
+            if (fc->st.st_size > param->max_read) {
+                return param->error = ERR_OVER_LIMIT;
+            }
+            if (!(param->need_mmap && fc->mmap_file(fd, fc->st.st_size))) {
                 fc->resize_buf(fc->st.st_size);
-                int nread = read(fd, fc->filebuf.base, fc->filebuf.len);
-                if (nread != fc->filebuf.len) {
+                // NOTE: read may return less than requested, e.g. >= 2G on linux
+                size_t total = 0;
+                while (total < fc->filebuf.len) {
+                    ssize_t nread = read(fd, fc->filebuf.base + total, fc->filebuf.len - total);
+                    if (nread < 0 && errno == EINTR) continue;
+                    if (nread <= 0) break;
+                    total += nread;
+                }
+                if (total != fc->filebuf.len) {
                     hloge("Failed to read file: %s", filepath);
-                    param->error = ERR_READ_FILE;
-                    return NULL;
+                    return param->error = ERR_READ_FILE;
                 }
             }
-            const char* suffix = strrchr(filepath, '.');
-            if (suffix) {
-                http_content_type content_type = http_content_type_enum_by_suffix(suffix+1);
-                if (content_type == TEXT_HTML) {
-                    fc->content_type = "text/html; charset=utf-8";
-                } else if (content_type == TEXT_PLAIN) {
-                    fc->content_type = "text/plain; charset=utf-8";
-                } else {
-                    fc->content_type = http_content_type_str_by_suffix(suffix+1);
-                }
+        }
+        else if (fc->fd < 0) {
+            // NOTE: keep fd for read_range, close in ~file_cache_s
+            fc->fd = fd;
+            fd = -1;
+        }
+        const char* suffix = strrchr(filepath, '.');
+        if (suffix) {
+            http_content_type content_type = http_content_type_enum_by_suffix(suffix+1);
+            if (content_type == TEXT_HTML) {
+                fc->content_type = "text/html; charset=utf-8";
+            } else if (content_type == TEXT_PLAIN) {
+                fc->content_type = "text/plain; charset=utf-8";
+            } else {
+                fc->content_type = http_content_type_str_by_suffix(suffix+1);
             }
         }
-        else if (S_ISDIR(fc->st.st_mode)) {
-            // DIR
-            std::string page;
-            make_index_of_page(filepath, page, param->path);
-            fc->resize_buf(page.size());
-            memcpy(fc->filebuf.base, page.c_str(), page.size());
-            fc->content_type = "text/html; charset=utf-8";
+    }
+    else if (S_ISDIR(fc->st.st_mode)) {
+        // DIR
+        std::string page;
+        make_index_of_page(filepath, page, param->path);
+        fc->resize_buf(page.size());
+        memcpy(fc->filebuf.base, page.c_str(), page.size());
+        fc->content_type = "text/html; charset=utf-8";
+    }
+    gmtime_fmt(fc->st.st_mtime, fc->last_modified);
+    snprintf(fc->etag, sizeof(fc->etag), ETAG_FMT, (size_t)fc->st.st_mtime, (size_t)fc->st.st_size);
+    return 0;
+}
+
+file_cache_ptr FileCache::AsyncOpen(const char* filepath, OpenParam* param, file_cache_cb cb) {
+    {
+        std::lock_guard<std::mutex> locker(mutex_);
+        file_cache_ptr fc = Get(filepath);
+        if (fc && fc->is_complete() &&
+            time(NULL) - fc->stat_time <= file_stat_interval) {
+            // cache hit
+            param->filesize = fc->st.st_size;
+            param->need_read = false;
+            return fc;
+        }
+        std::list<file_cache_cb>& waiters = loading_files[filepath];
+        waiters.push_back(std::move(cb));
+        if (waiters.size() > 1) {
+            // already loading, wait for it
+            return NULL;
+        }
+        if (file_load_pool == NULL) {
+            file_load_pool.reset(new HThreadPool(file_load_threads));
+            file_load_pool->start();
         }
-        gmtime_fmt(fc->st.st_mtime, fc->last_modified);
-        snprintf(fc->etag, sizeof(fc->etag), ETAG_FMT, (size_t)fc->st.st_mtime, (size_t)fc->st.st_size);
     }
-    return fc;
+    std::string file(filepath), path(param->path);
+    OpenParam load_param = *param;
+    file_load_pool->commit([this, file, path, load_param]() {
+        AsyncLoad(file, path, load_param);
+    });
+    return NULL;
+}
+
+void FileCache::AsyncLoad(const std::string& filepath, const std::string& path, OpenParam param) {
+    param.need_read = true;
+    param.path = path.c_str();
+    file_cache_ptr fc;
+    bool fresh = false;
+    // NOTE: stat into a local, fc->st is read by loop threads under mutex_
+    struct stat st;
+    if (stat(filepath.c_str(), &st) == 0) {
+        std::lock_guard<std::mutex> locker(mutex_);
+        fc = Get(filepath.c_str());
+        if (fc && fc->is_complete() &&
+            fc->st.st_mtime == st.st_mtime && fc->st.st_size == st.st_size) {
+            // NOTE: just stat expired, no need to read again
+            fc->stat_time = time(NULL);
+            fc->stat_cnt++;
+            fresh = true;
+        }
+    }
+    if (!fresh) {
+        // NOTE: load into a new file_cache_t, the old one may be sending now.
+        fc.reset(new file_cache_t);
+        if (Load(filepath.c_str(), fc.get(), true, &param) != 0) {
+            fc = NULL;
+        }
+    }
+
+    std::list<file_cache_cb> waiters;
+    {
+        std::lock_guard<std::mutex> locker(mutex_);
+        if (fc) {
+            cached_files[filepath] = fc;
+        }
+        auto iter = loading_files.find(filepath);
+        if (iter != loading_files.end()) {
+            waiters.swap(iter->second);
+            loading_files.erase(iter);
+        }
+    }
+    for (auto& cb : waiters) {
+        if (cb) cb(fc, param.error);
+    }
 }
 
 bool FileCache::Close(const char* filepath) {
@@ -3,11 +3,18 @@
 
 #include <memory>
 #include <map>
+#include <list>
 #include <string>
 #include <mutex>
+#include <functional>
 
 #include "hbuf.h"
 #include "hstring.h"
+#include "hthreadpool.h"
+
+#ifdef OS_UNIX
+#include <sys/mman.h>
+#endif
 
 #define HTTP_HEADER_MAX_LENGTH      1024        // 1K
 #define FILE_CACHE_MAX_SIZE         (1 << 26)   // 64M
@@ -24,9 +31,24 @@ typedef struct file_cache_s {
     char        last_modified[64];
     char        etag[64];
     std::string content_type;
+    // NOTE: if mmaped, filebuf is read-only mapped file pages shared by all processes,
+    // no room to prepend_header, send header and filebuf by writev.
+    bool        mmaped;
+    // NOTE: keep fd opened if file content not read, for read_range without reopen.
+    int         fd;
 
     file_cache_s() {
         stat_cnt = 0;
+        mmaped = false;
+        fd = -1;
+    }
+
+    ~file_cache_s() {
+        munmap_file();
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
     }
 
     bool is_modified() {
@@ -42,17 +64,75 @@ typedef struct file_cache_s {
         return filebuf.len == st.st_size;
     }
 
-    void resize_buf(int filesize) {
+    // read [offset, offset+len) from filebuf if complete, else from fd.
+    ssize_t read_range(char* dst, long offset, size_t len) {
+        if (is_complete()) {
+            memcpy(dst, filebuf.base + offset, len);
+            return len;
+        }
+#ifdef OS_UNIX
+        if (fd < 0) return -1;
+        return pread(fd, dst, len, offset);
+#else
+        int flags = O_RDONLY;
+#ifdef O_BINARY
+        flags |= O_BINARY;
+#endif
+        int rfd = open(filepath.c_str(), flags);
+        if (rfd < 0) return -1;
+        lseek(rfd, offset, SEEK_SET);
+        ssize_t nread = read(rfd, dst, len);
+        close(rfd);
+        return nread;
+#endif
+    }
+
+    // NOTE: Replace files by rename instead of truncating them in place,
+    // reading a truncated mapping raises SIGBUS, MAP_PRIVATE does not help
+    // as untouched pages still come from the file. A modified file is only
+    // noticed by re-stat after file_stat_interval, then mapped anew.
+    bool mmap_file(int fd, size_t filesize) {
+#ifdef OS_UNIX
+        if (fd < 0 || filesize == 0) return false;
+        void* addr = mmap(NULL, filesize, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) return false;
+        munmap_file();
+        buf.cleanup();
+        filebuf.base = (char*)addr;
+        filebuf.len = filesize;
+        httpbuf.base = NULL;
+        httpbuf.len = 0;
+        mmaped = true;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void munmap_file() {
+#ifdef OS_UNIX
+        if (mmaped) {
+            munmap(filebuf.base, filebuf.len);
+            filebuf.base = NULL;
+            filebuf.len = 0;
+            mmaped = false;
+        }
+#endif
+    }
+
+    void resize_buf(size_t filesize) {
+        munmap_file();
         buf.resize(HTTP_HEADER_MAX_LENGTH + filesize);
         filebuf.base = buf.base + HTTP_HEADER_MAX_LENGTH;
         filebuf.len = filesize;
     }
 
-    void prepend_header(const char* header, int len) {
-        if (len > HTTP_HEADER_MAX_LENGTH) return;
+    bool prepend_header(const char* header, int len) {
+        if (mmaped || len > HTTP_HEADER_MAX_LENGTH) return false;
         httpbuf.base = filebuf.base - len;
         httpbuf.len = len + filebuf.len;
         memcpy(httpbuf.base, header, len);
+        return true;
     }
 } file_cache_t;
 
@@ -60,23 +140,34 @@ typedef std::shared_ptr<file_cache_t>           file_cache_ptr;
 // filepath => file_cache_ptr
 typedef std::map<std::string, file_cache_ptr>   FileCacheMap;
 
+// @param fc: NULL if failed
+// @param error: ERR_OPEN_FILE, ERR_MISMATCH, ERR_OVER_LIMIT, ERR_READ_FILE
+typedef std::function<void(const file_cache_ptr& fc, int error)> file_cache_cb;
+// filepath => waiting callbacks
+typedef std::map<std::string, std::list<file_cache_cb>> FileLoadingMap;
+
 #define DEFAULT_FILE_STAT_INTERVAL      10 // s
 #define DEFAULT_FILE_EXPIRED_TIME       60 // s
+#define DEFAULT_FILE_LOAD_THREADS       4
 class FileCache {
 public:
     int file_stat_interval;
     int file_expired_time;
+    int file_load_threads;
     FileCacheMap    cached_files;
+    FileLoadingMap  loading_files;
     std::mutex      mutex_;
 
     FileCache() {
         file_stat_interval = DEFAULT_FILE_STAT_INTERVAL;
         file_expired_time  = DEFAULT_FILE_EXPIRED_TIME;
+        file_load_threads  = DEFAULT_FILE_LOAD_THREADS;
     }
 
     struct OpenParam {
         bool need_read;
         int  max_read;
+        bool need_mmap;
         const char* path;
         size_t  filesize;
         int  error;
@@ -84,18 +175,31 @@ public:
         OpenParam() {
             need_read = true;
             max_read = FILE_CACHE_MAX_SIZE;
+            need_mmap = false;
             path = "/";
             filesize = 0;
             error = 0;
         }
     };
     file_cache_ptr Open(const char* filepath, OpenParam* param);
+    // Non-blocking Open for need_read:
+    // return fc if cached and fresh, else return NULL and load file in file_load_pool,
+    // cb will be called in file_load_pool thread when loaded.
+    // NOTE: concurrent AsyncOpen of the same filepath share one load.
+    // @retval NULL && param->error == 0: loading
+    file_cache_ptr AsyncOpen(const char* filepath, OpenParam* param, file_cache_cb cb);
     bool Close(const char* filepath);
     bool Close(const file_cache_ptr& fc);
     void RemoveExpiredFileCache();
 
 protected:
     file_cache_ptr Get(const char* filepath);
+    // open -> fstat -> read => fc, without lock
+    int  Load(const char* filepath, file_cache_t* fc, bool need_stat, OpenParam* param);
+    void AsyncLoad(const std::string& filepath, const std::string& path, OpenParam param);
+
+private:
+    std::shared_ptr<HThreadPool> file_load_pool;
 };
 
 #endif // HV_FILE_CACHE_H_
@@ -0,0 +1,221 @@
+#include "GrpcServer.h"
+
+#include "hlog.h"
+#include "EventLoop.h"
+#include "HttpHandler.h"
+#include "Http2Parser.h"
+
+namespace hv {
+
+GrpcCall::GrpcCall() {
+    stream_id = 0;
+    loop = NULL;
+    max_message_size = DEFAULT_GRPC_MAX_MESSAGE_SIZE;
+    recv_num = 0;
+    headers_sent = false;
+    finished = false;
+    closed = false;
+}
+
+void* GrpcCall::getParser() {
+#ifdef WITH_NGHTTP2
+    if (closed || writer == NULL || !writer->isConnected()) return NULL;
+    HttpHandler* handler = (HttpHandler*)hevent_userdata(writer->io());
+    if (handler == NULL || handler->writer != writer || handler->protocol != HttpHandler::HTTP_V2) return NULL;
+    return handler->parser.get();
+#else
+    return NULL;
+#endif
+}
+
+void GrpcCall::flush() {
+#ifdef WITH_NGHTTP2
+    Http2Parser* parser = (Http2Parser*)getParser();
+    // NOTE: sent by on_recv after FeedRecvData
+    if (parser == NULL || parser->recving) return;
+    HttpHandler* handler = (HttpHandler*)hevent_userdata(writer->io());
+    handler->SendHttpResponse();
+#endif
+}
+
+int GrpcCall::Write(const char* data, size_t size) {
+    if (loop && !loop->isInLoopThread()) {
+        std::string msg(data, size);
+        GrpcCallPtr self = shared_from_this();
+        loop->runInLoop([self, msg]() {
+            self->Write(msg);
+        });
+        return size;
+    }
+#ifdef WITH_NGHTTP2
+    Http2Parser* parser = (Http2Parser*)getParser();
+    if (parser == NULL || finished) return -1;
+    if (!headers_sent) {
+        http2_stream* stream = parser->GetStream(stream_id);
+        if (stream == NULL) return -1;
+        stream->resp->status_code = HTTP_STATUS_OK;
+        stream->resp->headers["content-type"] = http_content_type_str(APPLICATION_GRPC);
+        parser->SubmitStreamHeaders(stream_id);
+        headers_sent = true;
+    }
+    grpc_message_hd msghd;
+    msghd.flags = 0;
+    msghd.length = size;
+    unsigned char hdbuf[GRPC_MESSAGE_HDLEN];
+    grpc_message_hd_pack(&msghd, hdbuf);
+    parser->SendStreamData(stream_id, hdbuf, GRPC_MESSAGE_HDLEN);
+    parser->SendStreamData(stream_id, data, size);
+    flush();
+    return size;
+#else
+    return -1;
+#endif
+}
+
+int GrpcCall::Finish(int status, const std::string& message) {
+    if (loop && !loop->isInLoopThread()) {
+        GrpcCallPtr self = shared_from_this();
+        loop->runInLoop([self, status, message]() {
+            self->Finish(status, message);
+        });
+        return 0;
+    }
+#ifdef WITH_NGHTTP2
+    Http2Parser* parser = (Http2Parser*)getParser();
+    if (parser == NULL || finished) return -1;
+    finished = true;
+    http_headers trailers;
+    trailers["grpc-status"] = hv::to_string(status);
+    if (!message.empty()) {
+        trailers["grpc-message"] = message;
+    }
+    if (headers_sent) {
+        parser->SubmitStreamTrailers(stream_id, trailers);
+    } else {
+        // Trailers-Only
+        http2_stream* stream = parser->GetStream(stream_id);
+        if (stream == NULL) return -1;
+        stream->resp->status_code = HTTP_STATUS_OK;
+        stream->resp->headers["content-type"] = http_content_type_str(APPLICATION_GRPC);
+        for (auto& header : trailers) {
+            stream->resp->headers[header.first] = header.second;
+        }
+        parser->SubmitStreamHeaders(stream_id, true);
+        headers_sent = true;
+    }
+    flush();
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void GrpcCall::FeedRecvData(const char* data, size_t size) {
+    grpc_message_hd msghd;
+    while (size > 0 && !finished) {
+        // NOTE: whole message in this DATA, no copy
+        if (recvbuf.empty() && size >= GRPC_MESSAGE_HDLEN) {
+            grpc_message_hd_unpack(&msghd, (const unsigned char*)data);
+            size_t msglen = GRPC_MESSAGE_HDLEN + msghd.length;
+            if (!(msghd.flags & GRPC_MESSAGE_FLAG_COMPRESSED) &&
+                msghd.length <= max_message_size && size >= msglen) {
+                onMessage(data + GRPC_MESSAGE_HDLEN, msghd.length);
+                data += msglen;
+                size -= msglen;
+                continue;
+            }
+        }
+        size_t need = GRPC_MESSAGE_HDLEN - recvbuf.size();
+        if (recvbuf.size() >= GRPC_MESSAGE_HDLEN) {
+            grpc_message_hd_unpack(&msghd, (const unsigned char*)recvbuf.data());
+            need = GRPC_MESSAGE_HDLEN + msghd.length - recvbuf.size();
+        }
+        size_t nread = MIN(need, size);
+        recvbuf.append(data, nread);
+        data += nread;
+        size -= nread;
+        if (recvbuf.size() < GRPC_MESSAGE_HDLEN) break;
+        grpc_message_hd_unpack(&msghd, (const unsigned char*)recvbuf.data());
+        // NOTE: only identity encoding, so no compression negotiated
+        if (msghd.flags & GRPC_MESSAGE_FLAG_COMPRESSED) {
+            hlogw("grpc compressed message not supported");
+            Finish(GRPC_STATUS_UNIMPLEMENTED, "compression not supported");
+            break;
+        }
+        if (msghd.length > max_message_size) {
+            hlogw("grpc message too large: %u", msghd.length);
+            Finish(GRPC_STATUS_RESOURCE_EXHAUSTED, "message too large");
+            break;
+        }
+        if (recvbuf.size() == GRPC_MESSAGE_HDLEN + msghd.length) {
+            onMessage(recvbuf.data() + GRPC_MESSAGE_HDLEN, msghd.length);
+            recvbuf.clear();
+        }
+    }
+}
+
+void GrpcCall::onMessage(const char* data, size_t size) {
+    ++recv_num;
+    if (onmessage) {
+        onmessage(data, size);
+    }
+}
+
+void GrpcCall::OnClose() {
+    if (closed) return;
+    closed = true;
+    if (onclose) {
+        onclose();
+    }
+    // NOTE: break cycles of callbacks capturing call
+    onmessage = NULL;
+    onend = NULL;
+    onclose = NULL;
+}
+
+void GrpcService::Unary(const char* method, grpc_unary_handler handler) {
+    methods[method] = [handler](const GrpcCallPtr& call) {
+        GrpcCall* c = call.get();
+        call->onmessage = [c, handler](const char* data, size_t size) {
+            if (c->recv_num > 1) {
+                c->Finish(GRPC_STATUS_INTERNAL, "too many requests");
+                return;
+            }
+            std::string reply;
+            int status = handler(c->shared_from_this(), data, size, &reply);
+            if (status == GRPC_STATUS_OK) {
+                c->Write(reply);
+            }
+            c->Finish(status);
+        };
+        call->onend = [c]() {
+            if (c->recv_num == 0) {
+                c->Finish(GRPC_STATUS_INTERNAL, "missing request message");
+            }
+        };
+    };
+}
+
+void GrpcService::ServerStreaming(const char* method, grpc_server_streaming_handler handler) {
+    methods[method] = [handler](const GrpcCallPtr& call) {
+        GrpcCall* c = call.get();
+        call->onmessage = [c, handler](const char* data, size_t size) {
+            if (c->recv_num > 1) {
+                c->Finish(GRPC_STATUS_INTERNAL, "too many requests");
+                return;
+            }
+            handler(c->shared_from_this(), data, size);
+        };
+        call->onend = [c]() {
+            if (c->recv_num == 0) {
+                c->Finish(GRPC_STATUS_INTERNAL, "missing request message");
+            }
+        };
+    };
+}
+
+void GrpcService::Streaming(const char* method, grpc_streaming_handler handler) {
+    methods[method] = handler;
+}
+
+}
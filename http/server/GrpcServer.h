@@ -0,0 +1,106 @@
+#ifndef HV_GRPC_SERVER_H_
+#define HV_GRPC_SERVER_H_
+
+/*
+ * @demo examples/grpc_server_test.cpp
+ */
+
+#include <map>
+#include <string>
+#include <memory>
+#include <functional>
+
+#include "HttpServer.h"
+#include "grpcdef.h"
+
+namespace hv {
+
+class EventLoop;
+
+// One call per HTTP/2 stream.
+// NOTE: Write/Finish can be called in any thread,
+// callbacks are called in loop thread.
+class HV_EXPORT GrpcCall : public std::enable_shared_from_this<GrpcCall> {
+public:
+    // :path and metadata in headers
+    HttpRequestPtr  request;
+    int32_t         stream_id;
+
+    // message is valid only in the callback
+    std::function<void(const char* data, size_t size)>  onmessage;
+    // client half-closed, no more messages
+    std::function<void()>                               onend;
+    // stream closed, reset by client or connection closed
+    std::function<void()>                               onclose;
+
+    GrpcCall();
+
+    // write one message
+    int Write(const char* data, size_t size);
+    int Write(const std::string& msg) {
+        return Write(msg.data(), msg.size());
+    }
+    // send trailers grpc-status, grpc-message
+    int Finish(int status = GRPC_STATUS_OK, const std::string& message = "");
+
+    bool IsFinished()   { return finished; }
+    bool IsClosed()     { return closed; }
+
+    // for GrpcService
+    HttpResponseWriterPtr   writer;
+    EventLoop*              loop;
+    size_t                  max_message_size;
+    uint64_t                recv_num;
+    // called with DATA of stream
+    void FeedRecvData(const char* data, size_t size);
+    void OnClose();
+
+private:
+    void onMessage(const char* data, size_t size);
+    // @return Http2Parser of connection, NULL if closed
+    void* getParser();
+    void flush();
+
+private:
+    bool            headers_sent;
+    bool            finished;
+    bool            closed;
+    // partial message across DATA frames
+    std::string     recvbuf;
+};
+typedef std::shared_ptr<GrpcCall> GrpcCallPtr;
+
+// unary: return grpc_status, fill reply if GRPC_STATUS_OK
+typedef std::function<int(const GrpcCallPtr& call, const char* data, size_t size, std::string* reply)>  grpc_unary_handler;
+// server streaming: call->Write ... call->Finish
+typedef std::function<void(const GrpcCallPtr& call, const char* data, size_t size)>                     grpc_server_streaming_handler;
+// client/bidi streaming: set call->onmessage, call->onend, then call->Write ... call->Finish
+typedef std::function<void(const GrpcCallPtr& call)>                                                     grpc_streaming_handler;
+
+#define DEFAULT_GRPC_MAX_MESSAGE_SIZE   (4 << 20) // 4M
+
+struct HV_EXPORT GrpcService {
+    // /package.Service/Method => handler
+    std::map<std::string, grpc_streaming_handler>   methods;
+    size_t max_message_size;
+
+    GrpcService() {
+        max_message_size = DEFAULT_GRPC_MAX_MESSAGE_SIZE;
+    }
+
+    // service.Unary("/helloworld.Greeter/SayHello", say_hello);
+    void Unary(const char* method, grpc_unary_handler handler);
+    void ServerStreaming(const char* method, grpc_server_streaming_handler handler);
+    void Streaming(const char* method, grpc_streaming_handler handler);
+};
+
+class GrpcServer : public HttpServer {
+public:
+    void registerGrpcService(GrpcService* service) {
+        this->grpc = service;
+    }
+};
+
+}
+
+#endif // HV_GRPC_SERVER_H_
@@ -0,0 +1,172 @@
+#include "HttpAccessLog.h"
+
+#include "hbase.h"
+#include "htime.h"
+#include "ThreadLocalStorage.h"
+
+static hv::ThreadLocalStorage s_ring_tls;
+
+AccessLogRing::AccessLogRing(logger_t* logger, int size, int sample)
+    : logger(logger)
+    , sample(sample)
+    , counter(0)
+    , dropped(0)
+    , reported_dropped(0)
+    , head(0)
+    , tail(0)
+{
+    // round up to power of 2
+    size_t capacity = 1;
+    while (capacity < (size_t)size) capacity <<= 1;
+    records.resize(capacity);
+    mask = capacity - 1;
+}
+
+bool AccessLogRing::Push(long pid, long tid, const char* ip, int port,
+                         http_method method, const char* path, int status_code) {
+    if (sample > 1 && status_code < 400 && (counter++ % sample) != 0) {
+        return false;
+    }
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t size = h - tail.load(std::memory_order_acquire);
+    if (size >= records.size()) {
+        ++dropped;
+        return false;
+    }
+    access_log_record& record = records[h & mask];
+    record.pid = pid;
+    record.tid = tid;
+    safe_strncpy(record.ip, ip, sizeof(record.ip));
+    record.port = port;
+    record.method = method;
+    record.status_code = status_code;
+    safe_strncpy(record.path, path, sizeof(record.path));
+    head.store(h + 1, std::memory_order_release);
+    // NOTE: wakeup writer thread early under heavy load
+    if (size + 1 == records.size() / 2) {
+        HttpAccessLog::instance()->Notify();
+    }
+    return true;
+}
+
+HttpAccessLog* HttpAccessLog::instance() {
+    static HttpAccessLog s_access_log;
+    return &s_access_log;
+}
+
+HttpAccessLog::~HttpAccessLog() {
+    {
+        std::lock_guard<std::mutex> locker(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (auto& pair : loggers_) {
+        if (pair.second != hlog) {
+            logger_destroy(pair.second);
+        }
+    }
+}
+
+AccessLogRing* HttpAccessLog::Register(const char* filepath, int sample, int ring_size) {
+    std::lock_guard<std::mutex> locker(mutex_);
+    std::shared_ptr<AccessLogRing> ring(new AccessLogRing(getLogger(filepath), ring_size, sample));
+    rings_.push_back(ring);
+    s_ring_tls.set(ring.get());
+    // NOTE: start writer thread here but not in constructor,
+    // so that forked worker processes own their writer threads.
+    if (!running_) {
+        running_ = true;
+        thread_ = std::thread(&HttpAccessLog::run, this);
+    }
+    return ring.get();
+}
+
+void HttpAccessLog::Unregister() {
+    AccessLogRing* ring = ThreadRing();
+    if (ring == NULL) return;
+    std::lock_guard<std::mutex> locker(mutex_);
+    flush();
+    for (auto iter = rings_.begin(); iter != rings_.end(); ++iter) {
+        if (iter->get() == ring) {
+            rings_.erase(iter);
+            break;
+        }
+    }
+    s_ring_tls.set(NULL);
+}
+
+AccessLogRing* HttpAccessLog::ThreadRing() {
+    return (AccessLogRing*)s_ring_tls.get();
+}
+
+logger_t* HttpAccessLog::getLogger(const char* filepath) {
+    std::string path(filepath ? filepath : "");
+    auto iter = loggers_.find(path);
+    if (iter != loggers_.end()) {
+        return iter->second;
+    }
+    logger_t* logger = hlog;
+    if (!path.empty()) {
+        logger = logger_create();
+        logger_set_file(logger, path.c_str());
+        logger_set_level(logger, LOG_LEVEL_INFO);
+        // NOTE: fsync by writer thread once per batch
+        logger_enable_fsync(logger, 0);
+    }
+    loggers_[path] = logger;
+    return logger;
+}
+
+void HttpAccessLog::run() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    while (running_) {
+        cond_.wait_for(locker, std::chrono::milliseconds(DEFAULT_ACCESS_LOG_FLUSH_INTERVAL));
+        flush();
+    }
+    flush();
+}
+
+// NOTE: called with mutex_ locked
+int HttpAccessLog::flush() {
+    int num = 0;
+    // NOTE: same prefix as logger_print, once per flush
+    char prefix[64];
+    datetime_t dt = datetime_now();
+    int prefix_len = snprintf(prefix, sizeof(prefix), "%04d-%02d-%02d %02d:%02d:%02d.%03d INFO  ",
+        dt.year, dt.month, dt.day, dt.hour, dt.min, dt.sec, dt.ms);
+    for (auto& ring : rings_) {
+        // NOTE: format records into buf_, then one write per ring
+        std::string& buf = buf_;
+        buf.clear();
+        int n = ring->PopAll([&buf, prefix, prefix_len](const access_log_record& record) {
+            char line[ACCESS_LOG_MAX_PATH + 256];
+            int len = snprintf(line, sizeof(line), "[%ld-%ld][%s:%d][%s %s]=>[%d %s]\n",
+                record.pid, record.tid,
+                record.ip, record.port,
+                http_method_str(record.method), record.path,
+                record.status_code, http_status_str((enum http_status)record.status_code));
+            buf.append(prefix, prefix_len);
+            buf.append(line, MIN(len, (int)sizeof(line) - 1));
+        });
+        if (n > 0) {
+            logger_write(ring->logger, LOG_LEVEL_INFO, buf.data(), buf.size());
+            num += n;
+        }
+        uint64_t dropped = ring->dropped;
+        if (dropped != ring->reported_dropped) {
+            hlogw("access log dropped %llu records", (unsigned long long)(dropped - ring->reported_dropped));
+            ring->reported_dropped = dropped;
+        }
+    }
+    for (auto& pair : loggers_) {
+        if (pair.second != hlog) {
+            logger_fsync(pair.second);
+        }
+    }
+    // NOTE: fsync hlog here instead of loop idle
+    hlog_fsync();
+    return num;
+}
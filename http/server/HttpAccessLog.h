@@ -0,0 +1,112 @@
+#ifndef HV_HTTP_ACCESS_LOG_H_
+#define HV_HTTP_ACCESS_LOG_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "hlog.h"
+#include "httpdef.h"
+
+#define DEFAULT_ACCESS_LOG_RING_SIZE        4096    // records per loop
+#define DEFAULT_ACCESS_LOG_FLUSH_INTERVAL   100     // ms
+#define ACCESS_LOG_MAX_PATH                 256
+
+struct access_log_record {
+    long        pid;
+    long        tid;
+    char        ip[64];
+    int         port;
+    http_method method;
+    int         status_code;
+    char        path[ACCESS_LOG_MAX_PATH];
+};
+
+// NOTE: single producer (loop thread), single consumer (writer thread)
+class AccessLogRing {
+public:
+    AccessLogRing(logger_t* logger, int size, int sample);
+
+    // @retval false if sampled out or dropped
+    bool Push(long pid, long tid, const char* ip, int port,
+              http_method method, const char* path, int status_code);
+
+    // @return number of records
+    template<typename Fn>
+    int PopAll(Fn fn) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        int num = h - t;
+        for (; t != h; ++t) {
+            fn(records[t & mask]);
+        }
+        tail.store(t, std::memory_order_release);
+        return num;
+    }
+
+    size_t Size() {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+public:
+    logger_t*               logger;
+    // log 1 of every sample requests, errors are always logged
+    int                     sample;
+    unsigned int            counter;
+    std::atomic<uint64_t>   dropped;
+    uint64_t                reported_dropped;
+
+private:
+    std::vector<access_log_record>  records;
+    size_t                          mask;
+    std::atomic<size_t>             head; // write by producer
+    std::atomic<size_t>             tail; // write by consumer
+};
+
+// Per-loop rings of access_log_record, formatted and written by
+// one background thread per process in batches.
+class HttpAccessLog {
+public:
+    static HttpAccessLog* instance();
+
+    ~HttpAccessLog();
+
+    // create ring for current loop thread, start writer thread if not started.
+    // @param filepath: NULL or "" means write into hlog
+    AccessLogRing* Register(const char* filepath, int sample = 1,
+                            int ring_size = DEFAULT_ACCESS_LOG_RING_SIZE);
+    // flush and remove ring of current loop thread
+    void Unregister();
+
+    // @return ring of current loop thread, NULL if not registered
+    static AccessLogRing* ThreadRing();
+
+    // wakeup writer thread, called by producer when ring is half full
+    void Notify() {
+        cond_.notify_one();
+    }
+
+private:
+    HttpAccessLog() : running_(false) {}
+    void run();
+    // @return number of records
+    int flush();
+    logger_t* getLogger(const char* filepath);
+
+private:
+    std::vector<std::shared_ptr<AccessLogRing>> rings_;
+    std::map<std::string, logger_t*>            loggers_;
+    std::mutex                                  mutex_;
+    std::condition_variable                     cond_;
+    std::thread                                 thread_;
+    bool                                        running_;
+    // formatted records of a ring, reused by flush
+    std::string                                 buf_;
+};
+
+#endif // HV_HTTP_ACCESS_LOG_H_
@@ -0,0 +1,159 @@
+#include "HttpEventStream.h"
+
+#include <assert.h>
+
+#include "hlog.h"
+#include "hthread.h"
+
+#define EVENT_STREAM_HEARTBEAT  ":\n\n"
+
+namespace hv {
+
+struct HttpEventStreamSubscriber {
+    HttpResponseWriterPtr   writer;
+    // events up to this were written, by history or published
+    uint64_t                last_id;
+};
+
+// subscribers of one loop, accessed in its loop only
+struct HttpEventStreamShard {
+    HttpEventStream*                        stream;
+    hloop_t*                                loop;
+    std::vector<HttpEventStreamSubscriber>  subscribers;
+    htimer_t*                               timer;
+};
+
+// one event posted to one loop
+struct HttpEventStreamDelivery {
+    std::shared_ptr<HttpEventStreamShard>   shard;
+    uint64_t                                id;
+    BufferPtr                               frame;
+};
+
+// @retval false if subscriber closed or too slow
+static bool write_event(HttpEventStreamSubscriber& sub, const char* data, size_t size, size_t max_write_bufsize) {
+    const HttpResponseWriterPtr& writer = sub.writer;
+    if (!writer->isConnected()) return false;
+    if (max_write_bufsize && hio_write_bufsize(writer->io()) > max_write_bufsize) {
+        hlogw("event stream: slow subscriber fd=%d closed", writer->fd());
+        // NOTE: async, not to delete handler while iterating subscribers
+        writer->close(true);
+        return false;
+    }
+    return writer->write(data, size) >= 0;
+}
+
+// writes to all subscribers of shard, removes the closed ones
+static void write_shard(HttpEventStreamShard* shard, uint64_t id, const char* data, size_t size) {
+    size_t max_write_bufsize = shard->stream->max_write_bufsize;
+    auto& subscribers = shard->subscribers;
+    size_t n = 0;
+    for (size_t i = 0; i < subscribers.size(); ++i) {
+        HttpEventStreamSubscriber& sub = subscribers[i];
+        // NOTE: written by history if subscribed after published
+        if (id && sub.last_id >= id) {
+        } else if (write_event(sub, data, size, max_write_bufsize)) {
+            if (id) sub.last_id = id;
+        } else {
+            continue;
+        }
+        if (n != i) subscribers[n] = std::move(sub);
+        ++n;
+    }
+    subscribers.resize(n);
+}
+
+static void on_delivery(hevent_t* ev) {
+    HttpEventStreamDelivery* delivery = (HttpEventStreamDelivery*)hevent_userdata(ev);
+    write_shard(delivery->shard.get(), delivery->id, (const char*)delivery->frame->data(), delivery->frame->size());
+    delete delivery;
+}
+
+static void on_heartbeat(htimer_t* timer) {
+    HttpEventStreamShard* shard = (HttpEventStreamShard*)hevent_userdata(timer);
+    write_shard(shard, 0, EVENT_STREAM_HEARTBEAT, sizeof(EVENT_STREAM_HEARTBEAT) - 1);
+}
+
+HttpEventStream::HttpEventStream(size_t history_size)
+    : history_size(history_size)
+    , heartbeat_interval(DEFAULT_EVENT_STREAM_HEARTBEAT_INTERVAL)
+    , max_write_bufsize(DEFAULT_EVENT_STREAM_MAX_WRITE_BUFSIZE)
+    , last_id_(0)
+{}
+
+HttpEventStream::~HttpEventStream() {
+    // NOTE: timers are freed with loops
+}
+
+HttpEventStream::ShardPtr HttpEventStream::getShard(hloop_t* loop) {
+    for (auto& shard : shards_) {
+        if (shard->loop == loop) return shard;
+    }
+    ShardPtr shard(new HttpEventStreamShard);
+    shard->stream = this;
+    shard->loop = loop;
+    shard->timer = NULL;
+    if (heartbeat_interval > 0) {
+        shard->timer = htimer_add(loop, on_heartbeat, heartbeat_interval, INFINITE);
+        hevent_set_userdata(shard->timer, shard.get());
+    }
+    shards_.push_back(shard);
+    return shard;
+}
+
+int HttpEventStream::Subscribe(const HttpRequestPtr& req, const HttpResponseWriterPtr& writer) {
+    if (!writer->isConnected()) return -1;
+    hloop_t* loop = hevent_loop(writer->io());
+    assert(hloop_tid(loop) == hv_gettid());
+    writer->BeginEventStream();
+
+    HttpEventStreamSubscriber sub;
+    sub.writer = writer;
+    std::lock_guard<std::mutex> locker(mutex_);
+    ShardPtr shard = getShard(loop);
+    // NOTE: resume after Last-Event-ID, else new events only
+    std::string last_event_id = req->GetHeader("Last-Event-ID");
+    if (!last_event_id.empty()) {
+        uint64_t id = strtoull(last_event_id.c_str(), NULL, 10);
+        for (auto& ev : history_) {
+            if (ev.id <= id) continue;
+            writer->WriteEvent(ev.frame);
+        }
+    }
+    // NOTE: events after it are delivered by loop, no duplicate nor missing
+    sub.last_id = last_id_;
+    shard->subscribers.push_back(sub);
+    return 0;
+}
+
+uint64_t HttpEventStream::Publish(const std::string& data, const char* event) {
+    std::string msg;
+    std::lock_guard<std::mutex> locker(mutex_);
+    uint64_t id = ++last_id_;
+    std::string id_str = hv::to_string(id);
+    dump_sse_event(msg, data.data(), data.size(), event, id_str.c_str());
+    BufferPtr frame(new Buffer(msg.size()));
+    memcpy(frame->data(), msg.data(), msg.size());
+    if (history_size > 0) {
+        history_.push_back({id, frame});
+        while (history_.size() > history_size) {
+            history_.pop_front();
+        }
+    }
+    // NOTE: posted in the lock, so that each loop receives events in order of id,
+    // even in loop thread, not to go before the events posted by other threads.
+    for (auto& shard : shards_) {
+        HttpEventStreamDelivery* delivery = new HttpEventStreamDelivery;
+        delivery->shard = shard;
+        delivery->id = id;
+        delivery->frame = frame;
+        hevent_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.cb = on_delivery;
+        ev.userdata = delivery;
+        hloop_post_event(shard->loop, &ev);
+    }
+    return id;
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef HV_HTTP_EVENT_STREAM_H_
+#define HV_HTTP_EVENT_STREAM_H_
+
+/*
+ * Server-Sent Events
+ * @see https://html.spec.whatwg.org/multipage/server-sent-events.html
+ *
+ * hv::HttpEventStream stream;
+ * service.EventStream("/events", &stream);
+ * stream.Publish("hello");
+ *
+ * NOTE: destroy HttpEventStream after the http server stopped.
+ */
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <memory>
+
+#include "hexport.h"
+#include "HttpResponseWriter.h"
+
+#define DEFAULT_EVENT_STREAM_HISTORY_SIZE       64
+#define DEFAULT_EVENT_STREAM_HEARTBEAT_INTERVAL 15000   // ms
+#define DEFAULT_EVENT_STREAM_MAX_WRITE_BUFSIZE  (1 << 20) // 1M
+
+namespace hv {
+
+struct HttpEventStreamShard;
+
+class HV_EXPORT HttpEventStream {
+public:
+    // events kept to resume from Last-Event-ID
+    size_t  history_size;
+    // ms, comment line written to subscribers, 0 means disabled
+    int     heartbeat_interval;
+    // slow subscriber is closed if its write queue over this,
+    // the client reconnects and resumes from Last-Event-ID.
+    size_t  max_write_bufsize;
+
+    HttpEventStream(size_t history_size = DEFAULT_EVENT_STREAM_HISTORY_SIZE);
+    ~HttpEventStream();
+
+    // Writes headers and events after Last-Event-ID of req, then subscribes writer.
+    // NOTE: call in loop thread of writer, i.e. in http handler.
+    int Subscribe(const HttpRequestPtr& req, const HttpResponseWriterPtr& writer);
+
+    // Encodes event once, with id in sequence, shared by all subscribers,
+    // and posts it once per loop, in order of id.
+    // NOTE: thread-safe
+    // @retval id of event
+    uint64_t Publish(const std::string& data, const char* event = NULL);
+
+private:
+    typedef std::shared_ptr<HttpEventStreamShard>   ShardPtr;
+    typedef std::vector<ShardPtr>                   ShardList;
+    struct Event {
+        uint64_t    id;
+        BufferPtr   frame;
+    };
+
+    ShardPtr getShard(hloop_t* loop);
+
+    std::mutex                  mutex_;
+    uint64_t                    last_id_;
+    std::deque<Event>           history_;
+    // one per loop of subscribers
+    ShardList                   shards_;
+};
+
+}
+
+#endif // HV_HTTP_EVENT_STREAM_H_
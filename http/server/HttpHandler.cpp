@@ -3,38 +3,158 @@
 #include "hbase.h"
 #include "herr.h"
 #include "hlog.h"
+#include "htime.h"
 #include "http_page.h"
 
+#include "EventLoop.h"
+#include "HttpAccessLog.h"
+#include "HttpRateLimiter.h"
+#include "HttpOverloadMonitor.h"
+#include "Http1Parser.h"
+#include "Http2Parser.h"
+
 int HttpHandler::customHttpHandler(const http_handler& handler) {
     return invokeHttpHandler(&handler);
 }
 
-int HttpHandler::invokeHttpHandler(const http_handler* handler) {
+// NOTE: static, so that blocking handlers can run in worker_pool
+// after the connection has been closed.
+static int invoke_http_handler(const http_handler* handler, const HttpContextPtr& ctx) {
     int status_code = HTTP_STATUS_NOT_IMPLEMENTED;
     if (handler->sync_handler) {
-        status_code = handler->sync_handler(req.get(), resp.get());
+        status_code = handler->sync_handler(ctx->request.get(), ctx->response.get());
     } else if (handler->async_handler) {
-        handler->async_handler(req, writer);
+        handler->async_handler(ctx->request, ctx->writer);
         status_code = HTTP_STATUS_UNFINISHED;
     } else if (handler->ctx_handler) {
-        HttpContextPtr ctx(new hv::HttpContext);
-        ctx->service = service;
-        ctx->request = req;
-        ctx->response = resp;
-        ctx->writer = writer;
         status_code = handler->ctx_handler(ctx);
-        if (writer->state != hv::HttpResponseWriter::SEND_BEGIN) {
+        if (ctx->writer->state != hv::HttpResponseWriter::SEND_BEGIN) {
             status_code = HTTP_STATUS_UNFINISHED;
         }
     }
     return status_code;
 }
 
+const HttpContextPtr& HttpHandler::getHttpContext() {
+    // NOTE: reuse ctx unless it is still referenced by last request
+    if (ctx == NULL || ctx.use_count() > 1) {
+        ctx.reset(new hv::HttpContext);
+    }
+    ctx->service = service;
+    ctx->request = req;
+    ctx->response = resp;
+    ctx->writer = writer;
+    return ctx;
+}
+
+bool HttpHandler::Hibernate() {
+    if (hibernated) return true;
+    if (protocol != HTTP_V1 || writer == NULL) return false;
+    // NOTE: HANDLE_CONTINUE and SEND_END if responded by writer
+    if (state != WANT_RECV && state != SEND_DONE &&
+        !(state == HANDLE_CONTINUE && writer->state == hv::HttpResponseWriter::SEND_END)) return false;
+    int parser_state = parser->GetState();
+    if (parser_state != HP_START_REQ_OR_RES && parser_state != HP_MESSAGE_COMPLETE) return false;
+    if (hio_write_bufsize(writer->io()) != 0) return false;
+    if (ctx && ctx.use_count() > 1) return false;
+    if (writer.use_count() > (ctx ? 2 : 1)) return false;
+
+    ctx = NULL;
+    writer->response = NULL;
+    req->head_cb = NULL;
+    req->body_cb = NULL;
+    req = NULL;
+    resp = NULL;
+    parser = NULL;
+    fc = NULL;
+    std::string().swap(header);
+    std::string().swap(body);
+    hibernated = true;
+    return true;
+}
+
+int HttpHandler::invokeHttpHandler(const http_handler* handler) {
+    return invoke_http_handler(handler, getHttpContext());
+}
+
+int HttpHandler::invokeBlockingHandler(const http_handler* handler) {
+    hv::EventLoop* loop = hv::tlsEventLoop();
+    if (loop == NULL || writer == NULL) {
+        return invokeHttpHandler(handler);
+    }
+    HttpContextPtr ctx = getHttpContext();
+    bool posted = service->worker_pool->Post([loop, handler, ctx]() {
+        int status_code = invoke_http_handler(handler, ctx);
+        HttpResponseWriterPtr writer = ctx->writer;
+        loop->runInLoop([writer, status_code]() {
+            // NOTE: connection may be closed while handling
+            if (!writer->isConnected()) return;
+            HttpHandler* handler = (HttpHandler*)hevent_userdata(writer->io());
+            if (handler == NULL || handler->writer != writer) return;
+            handler->resumeHttpRequest(status_code);
+        });
+    });
+    if (!posted) {
+        hlogw("[%s:%d] worker_pool is full, queue_size=%d", ip, port, service->worker_pool->QueueSize());
+        return HTTP_STATUS_SERVICE_UNAVAILABLE;
+    }
+    // NOTE: stop reading until the response is sent,
+    // req and resp are not ours until then.
+    writer->stopRead();
+    state = HANDLE_CONTINUE;
+    return HTTP_STATUS_UNFINISHED;
+}
+
+bool HttpHandler::checkRateLimit(bool check_ip, bool check_route) {
+    if (limiter == NULL || writer == NULL) return true;
+    uint64_t now_ms = hloop_now_ms(hevent_loop(writer->io()));
+    if (check_ip && !limiter->AllowRequest(ip, now_ms)) return false;
+    if (check_route && !limiter->AllowRoute(req->url.c_str(), now_ms)) return false;
+    return true;
+}
+
+bool HttpHandler::checkOverload() {
+    if (overload == NULL || overload->GetLevel() != HttpOverloadMonitor::OVERLOADED) return true;
+    ++service->limit_stats->shed_requests;
+    return false;
+}
+
+void HttpHandler::onHeadersComplete() {
+    req->body_cb = NULL;
+    abort_status = 0;
+    if (!checkRateLimit(false, true)) {
+        abort_status = HTTP_STATUS_TOO_MANY_REQUESTS;
+        return;
+    }
+    if (service->api_handlers.size() == 0) return;
+    if (req->headers.find("Content-Length") == req->headers.end() && !req->IsChunked()) return;
+
+    HttpRequest* pReq = req.get();
+    pReq->scheme = ssl ? "https" : "http";
+    pReq->client_addr.ip = ip;
+    pReq->client_addr.port = port;
+    pReq->Host();
+    pReq->ParseUrl();
+
+    http_handler* handler = NULL;
+    service->GetApi(pReq, &handler);
+    if (handler == NULL || handler->body_handler == NULL) return;
+    http_body_consumer consumer = handler->body_handler(getHttpContext());
+    if (consumer == NULL) return;
+    req->body_cb = [this, consumer](const char* data, size_t size) {
+        // NOTE: ignore the rest of body once aborted
+        if (abort_status == 0) {
+            abort_status = consumer(data, size);
+        }
+    };
+}
+
 int HttpHandler::HandleHttpRequest() {
     // preprocessor -> processor -> postprocessor
     int status_code = HTTP_STATUS_OK;
     HttpRequest* pReq = req.get();
-    HttpResponse* pResp = resp.get();
+    // NOTE: body has been consumed, release the consumer
+    pReq->body_cb = NULL;
 
     pReq->scheme = ssl ? "https" : "http";
     pReq->client_addr.ip = ip;
@@ -58,8 +178,19 @@ processor:
     } else {
         status_code = defaultRequestHandler();
     }
+    // NOTE: static file is loading or blocking handler is running,
+    // continue in resumeHttpRequest
+    if (state == HANDLE_CONTINUE) {
+        return HTTP_STATUS_UNFINISHED;
+    }
 
 postprocessor:
+    return finishHttpRequest(status_code);
+}
+
+int HttpHandler::finishHttpRequest(int status_code) {
+    HttpRequest* pReq = req.get();
+    HttpResponse* pResp = resp.get();
     if (status_code >= 100 && status_code < 600) {
         pResp->status_code = (http_status)status_code;
     }
@@ -76,6 +207,24 @@ postprocessor:
         pResp->headers["Content-Type"] = fc->content_type;
         pResp->headers["Last-Modified"] = fc->last_modified;
         pResp->headers["Etag"] = fc->etag;
+        if (protocol == HTTP_V2) {
+            // NOTE: DATA frames of stream may be sent after fc released,
+            // so the stream keeps fc, no copy filebuf.
+            bool owned = false;
+#ifdef WITH_NGHTTP2
+            Http2Parser* h2 = (Http2Parser*)parser.get();
+            http2_stream* stream = h2->GetStream(h2->stream_id);
+            if (stream && stream->resp == resp) {
+                stream->content_owner = fc;
+                owned = true;
+            }
+#endif
+            if (!owned) {
+                pResp->body.assign(fc->filebuf.base, fc->filebuf.len);
+                pResp->content = NULL;
+            }
+            fc = NULL;
+        }
     }
     if (service->postprocessor) {
         customHttpHandler(service->postprocessor);
@@ -99,7 +248,12 @@ int HttpHandler::defaultRequestHandler() {
     }
 
     if (handler) {
-        status_code = invokeHttpHandler(handler);
+        // NOTE: HTTP/2 streams are multiplexed, can not stop reading for one of them
+        if (handler->is_blocking && service->worker_pool && protocol != HTTP_V2) {
+            status_code = invokeBlockingHandler(handler);
+        } else {
+            status_code = invokeHttpHandler(handler);
+        }
     }
     else if (req->method == HTTP_GET || req->method == HTTP_HEAD) {
         // static handler
@@ -143,8 +297,28 @@ int HttpHandler::defaultStaticHandler() {
         FileCache::OpenParam param;
         bool has_range = req->headers.find("Range") != req->headers.end();
         param.need_read = req->method == HTTP_HEAD || has_range ? false : true;
+        param.need_mmap = service->file_cache_mmap;
         param.path = req_path;
-        fc = files->Open(filepath.c_str(), &param);
+        hv::EventLoop* loop = hv::tlsEventLoop();
+        if (service->async_file_load && param.need_read && loop && writer && protocol != HTTP_V2) {
+            HttpResponseWriterPtr writer = this->writer;
+            fc = files->AsyncOpen(filepath.c_str(), &param, [loop, writer](const file_cache_ptr& fc, int error) {
+                loop->runInLoop([writer, fc, error]() {
+                    // NOTE: connection may be closed while loading
+                    if (!writer->isConnected()) return;
+                    HttpHandler* handler = (HttpHandler*)hevent_userdata(writer->io());
+                    if (handler == NULL || handler->writer != writer) return;
+                    handler->onFileLoaded(fc, error);
+                });
+            });
+            if (fc == NULL && param.error == 0) {
+                writer->stopRead();
+                state = HANDLE_CONTINUE;
+                return HTTP_STATUS_UNFINISHED;
+            }
+        } else {
+            fc = files->Open(filepath.c_str(), &param);
+        }
         if (fc == NULL) {
             status_code = HTTP_STATUS_NOT_FOUND;
             if (param.error == ERR_OVER_LIMIT) {
@@ -157,6 +331,10 @@ int HttpHandler::defaultStaticHandler() {
         status_code = HTTP_STATUS_NOT_FOUND;
     }
 
+    return checkNotModified(status_code);
+}
+
+int HttpHandler::checkNotModified(int status_code) {
     if (fc) {
         // Not Modified
         auto iter = req->headers.find("if-not-match");
@@ -177,6 +355,51 @@ int HttpHandler::defaultStaticHandler() {
     return status_code;
 }
 
+void HttpHandler::onFileLoaded(const file_cache_ptr& fc, int error) {
+    if (state != HANDLE_CONTINUE) return;
+    this->fc = fc;
+    int status_code = HTTP_STATUS_OK;
+    if (fc == NULL) {
+        status_code = HTTP_STATUS_NOT_FOUND;
+        if (error == ERR_OVER_LIMIT) {
+            if (service->largeFileHandler) {
+                status_code = customHttpHandler(service->largeFileHandler);
+            }
+        }
+    }
+    resumeHttpRequest(checkNotModified(status_code));
+}
+
+void HttpHandler::resumeHttpRequest(int status_code) {
+    if (state != HANDLE_CONTINUE) return;
+    writer->startRead();
+    status_code = finishHttpRequest(status_code);
+    SendHttpResponse();
+    AccessLog();
+    // NOTE: closed by sendFileRangeChunks if sending ranges
+    if (status_code && !req->IsKeepAlive() && state != SEND_BODY) {
+        writer->close();
+    }
+}
+
+void HttpHandler::AccessLog() {
+    if (!service->access_log || writer == NULL) return;
+    hloop_t* loop = hevent_loop(writer->io());
+    AccessLogRing* ring = HttpAccessLog::ThreadRing();
+    if (ring) {
+        ring->Push(hloop_pid(loop), hloop_tid(loop),
+            ip, port,
+            req->method, req->path.c_str(),
+            resp->status_code);
+    } else {
+        hlogi("[%ld-%ld][%s:%d][%s %s]=>[%d %s]",
+            hloop_pid(loop), hloop_tid(loop),
+            ip, port,
+            http_method_str(req->method), req->path.c_str(),
+            resp->status_code, resp->status_message());
+    }
+}
+
 int HttpHandler::defaultErrorHandler() {
     // error page
     if (service->error_page.size() != 0) {
@@ -199,20 +422,138 @@ int HttpHandler::FeedRecvData(const char* data, size_t len) {
     if (protocol == HttpHandler::WEBSOCKET) {
         nfeed = ws->parser->FeedRecvData(data, len);
         if (nfeed != len) {
-            hloge("[%s:%d] websocket parse error!", ip, port);
+            hloge("[%s:%d] websocket parse error: %d", ip, port, ws->parser->close_code);
+            // NOTE: close frame is flushed before closed
+            if (ws->parser->close_code) {
+                ws->channel->sendClose(ws->parser->close_code);
+            }
+        }
+    } else if (protocol == HttpHandler::HTTP_V2) {
+        nfeed = parser->FeedRecvData(data, len);
+        if (nfeed != len) {
+            hloge("[%s:%d] http2 parse error: %s", ip, port, parser->StrError(parser->GetError()));
+        } else {
+            handleHttp2Requests();
         }
     } else {
         if (state != WANT_RECV) {
             Reset();
         }
+        // NOTE: reject before parsing, no HttpResponse, no access log
+        if (parser->GetState() == HP_START_REQ_OR_RES && writer) {
+            if (!checkOverload()) {
+                hlogd("[%s:%d] overloaded", ip, port);
+                writer->write(HTTP_SERVICE_UNAVAILABLE_RESPONSE, sizeof(HTTP_SERVICE_UNAVAILABLE_RESPONSE) - 1);
+                return -1;
+            }
+            if (!checkRateLimit(true, false)) {
+                hlogd("[%s:%d] too many requests", ip, port);
+                writer->write(HTTP_TOO_MANY_REQUESTS_RESPONSE, sizeof(HTTP_TOO_MANY_REQUESTS_RESPONSE) - 1);
+                return -1;
+            }
+        }
         nfeed = parser->FeedRecvData(data, len);
         if (nfeed != len) {
             hloge("[%s:%d] http parse error: %s", ip, port, parser->StrError(parser->GetError()));
+        } else if (abort_status != 0) {
+            // NOTE: body consumer aborted or rate limited, respond and close
+            hlogw("[%s:%d] request aborted: %d", ip, port, abort_status);
+            req->body_cb = NULL;
+            resp->headers["Connection"] = "close";
+            if (abort_status == HTTP_STATUS_TOO_MANY_REQUESTS) {
+                resp->headers["Retry-After"] = "1";
+            }
+            finishHttpRequest(abort_status);
+            SendHttpResponse();
+            AccessLog();
+            abort_status = 0;
+            return -1;
         }
     }
     return nfeed;
 }
 
+void HttpHandler::initHttp2() {
+#ifdef WITH_NGHTTP2
+    Http2Parser* h2 = (Http2Parser*)parser.get();
+    if (service) {
+        h2->max_concurrent_streams = service->http2_max_concurrent_streams;
+        h2->initial_window_size = service->http2_initial_window_size;
+    }
+    if (grpc_service) {
+        h2->onStreamHeaders = [this](http2_stream* stream) {
+            onHttp2StreamHeaders(stream);
+        };
+    }
+#endif
+}
+
+bool HttpHandler::onHttp2StreamHeaders(void* userdata) {
+#ifdef WITH_NGHTTP2
+    http2_stream* stream = (http2_stream*)userdata;
+    HttpRequest* pReq = stream->req.get();
+    if (pReq->ContentType() != APPLICATION_GRPC) return false;
+    auto iter = grpc_service->methods.find(pReq->url);
+    if (iter == grpc_service->methods.end()) {
+        // NOTE: fallback to HttpService if registered there
+        if (service && service->api_handlers.find(pReq->url) != service->api_handlers.end()) {
+            return false;
+        }
+    }
+
+    hv::GrpcCallPtr call(new hv::GrpcCall);
+    call->request = stream->req;
+    call->stream_id = stream->stream_id;
+    call->writer = writer;
+    call->loop = hv::tlsEventLoop();
+    call->max_message_size = grpc_service->max_message_size;
+    pReq->scheme = ssl ? "https" : "http";
+    pReq->client_addr.ip = ip;
+    pReq->client_addr.port = port;
+    pReq->ParseUrl();
+    pReq->body_cb = [call](const char* data, size_t size) {
+        call->FeedRecvData(data, size);
+    };
+    stream->onEnd = [call]() {
+        if (call->onend) call->onend();
+    };
+    stream->onClose = [call](uint32_t error_code) {
+        call->OnClose();
+    };
+    if (iter == grpc_service->methods.end()) {
+        call->Finish(GRPC_STATUS_UNIMPLEMENTED, "unknown method");
+    } else {
+        iter->second(call);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HttpHandler::handleHttp2Requests() {
+#ifdef WITH_NGHTTP2
+    Http2Parser* h2 = (Http2Parser*)parser.get();
+    while (h2->PopRequest(req, resp)) {
+        if (writer) {
+            writer->response = resp;
+        }
+        if (!checkOverload()) {
+            resp->headers["Retry-After"] = "1";
+            finishHttpRequest(HTTP_STATUS_SERVICE_UNAVAILABLE);
+        } else if (!checkRateLimit(true, true)) {
+            resp->headers["Retry-After"] = "1";
+            finishHttpRequest(HTTP_STATUS_TOO_MANY_REQUESTS);
+        } else {
+            HandleHttpRequest();
+        }
+        AccessLog();
+    }
+    // NOTE: unfinished stream must not block the others
+    state = WANT_RECV;
+#endif
+}
+
 int HttpHandler::GetSendData(char** data, size_t* len) {
     if (state == HANDLE_CONTINUE) {
         return 0;
@@ -248,66 +589,58 @@ int HttpHandler::GetSendData(char** data, size_t* len) {
             }
             // File service
             if (fc) {
-                long from, to, total;
-                int nread;
                 // Range:
-                if (pReq->GetRange(from, to)) {
-                    HFile file;
-                    if (file.open(fc->filepath.c_str(), "rb") != 0) {
-                        pResp->status_code = HTTP_STATUS_NOT_FOUND;
+                if (pReq->headers.find("Range") != pReq->headers.end()) {
+                    int status_code = sendFileRanges();
+                    if (status_code >= 400) {
                         state = SEND_DONE;
                         goto return_nobody;
                     }
-                    total = file.size();
-                    if (to == 0 || to >= total) to = total - 1;
-                    pResp->content_length = to - from + 1;
-                    nread = file.readrange(body, from, to);
-                    if (nread != pResp->content_length) {
-                        pResp->status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
-                        state = SEND_DONE;
-                        goto return_nobody;
+                    if (status_code != 0) {
+                        state = SEND_BODY;
+                        goto return_header;
                     }
-                    pResp->SetRange(from, to, total);
-                    state = SEND_BODY;
-                    goto return_header;
+                    // NOTE: Range ignored, send the whole filebuf
                 }
                 // FileCache
                 // NOTE: no copy filebuf, more efficient
-                header = pResp->Dump(true, false);
-                fc->prepend_header(header.c_str(), header.size());
-                *data = fc->httpbuf.base;
-                *len = fc->httpbuf.len;
-                state = SEND_DONE;
-                return *len;
-            }
-            // API service
-            content_length = pResp->ContentLength();
-            content = (const char*)pResp->Content();
-            if (content) {
-                if (content_length > (1 << 20)) {
-                    state = SEND_BODY;
-                    goto return_header;
-                } else {
-                    // NOTE: header+body in one package if <= 1M
-                    header = pResp->Dump(true, false);
-                    header.append(content, content_length);
+                pResp->Dump(header, true, false);
+                if (fc->prepend_header(header.c_str(), header.size())) {
+                    *data = fc->httpbuf.base;
+                    *len = fc->httpbuf.len;
                     state = SEND_DONE;
-                    goto return_header;
+                    return *len;
                 }
-            } else {
-                state = SEND_DONE;
+                // NOTE: mmaped filebuf, send header then filebuf by writev
+                state = SEND_BODY;
+                goto return_header;
+            }
+            // API service
+            {
+                // NOTE: header+body in one package if <= 1M,
+                // structured content not dumped yet counts as small.
+                size_t body_size = pResp->content ? pResp->content_length : pResp->body.size();
+                bool small_body = body_size <= (1 << 20);
+                pResp->Dump(header, true, small_body);
+                content_length = pResp->content_length;
+                content = (const char*)pResp->Content();
+                state = content && !small_body ? SEND_BODY : SEND_DONE;
                 goto return_header;
             }
 return_nobody:
             pResp->content_length = 0;
 return_header:
-            if (header.empty()) header = pResp->Dump(true, false);
+            if (header.empty()) pResp->Dump(header, true, false);
             *data = (char*)header.c_str();
             *len = header.size();
             return *len;
         }
         case SEND_BODY:
         {
+            // NOTE: written by sendFileRangeChunks after header
+            if (!ranges.empty()) {
+                return 0;
+            }
             if (body.empty()) {
                 *data = (char*)pResp->Content();
                 *len = pResp->ContentLength();
@@ -321,12 +654,14 @@ return_header:
         case SEND_DONE:
         {
             // NOTE: remove file cache if > 16M
-            if (fc && fc->filebuf.len > (1 << 24)) {
+            if (fc && !fc->mmaped && fc->filebuf.len > (1 << 24)) {
                 files->Close(fc);
             }
             fc = NULL;
             header.clear();
             body.clear();
+            ranges.clear();
+            range_boundary.clear();
             return 0;
         }
         default:
@@ -337,3 +672,185 @@ return_header:
     }
     return 0;
 }
+
+int HttpHandler::sendFileRanges() {
+    HttpRequest* pReq = req.get();
+    HttpResponse* pResp = resp.get();
+    long total = fc->st.st_size;
+    ranges.clear();
+    range_boundary.clear();
+    // NOTE: ignore malformed Range, send 200 with the whole file
+    if (!pReq->GetRanges(total, ranges)) {
+        return sendFileWhole();
+    }
+    if (ranges.empty()) {
+        pResp->status_code = HTTP_STATUS_RANGE_NOT_SATISFIABLE;
+        pResp->headers["Content-Range"] = hv::asprintf("bytes */%ld", total);
+        pResp->headers["Content-Length"] = "0";
+        return pResp->status_code;
+    }
+    // NOTE: coalesce overlapping or adjacent ranges, not to send bytes twice
+    std::sort(ranges.begin(), ranges.end());
+    size_t n = 0;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (ranges[i].first <= ranges[n].second + 1) {
+            ranges[n].second = MAX(ranges[n].second, ranges[i].second);
+        } else {
+            ranges[++n] = ranges[i];
+        }
+    }
+    ranges.resize(n + 1);
+    if (ranges.size() > HTTP_MAX_RANGES) {
+        return sendFileWhole();
+    }
+    pResp->status_code = HTTP_STATUS_PARTIAL_CONTENT;
+    pResp->content = NULL;
+    if (ranges.size() == 1) {
+        long from = ranges[0].first, to = ranges[0].second;
+        pResp->content_length = to - from + 1;
+        pResp->SetRange(from, to, total);
+        if (fc->is_complete()) {
+            // NOTE: no copy filebuf
+            pResp->content = fc->filebuf.base + from;
+            ranges.clear();
+            return pResp->status_code;
+        }
+    } else {
+        // multipart/byteranges
+        char boundary[32];
+        snprintf(boundary, sizeof(boundary), "%llx%zx", (unsigned long long)gethrtime_us(), (size_t)fc->st.st_mtime);
+        range_boundary = boundary;
+        size_t content_length = 0;
+        for (auto& range : ranges) {
+            content_length += rangePartHeader(range.first, range.second).size();
+            content_length += range.second - range.first + 1 + 2;
+        }
+        content_length += range_boundary.size() + 6;
+        pResp->headers["Content-Type"] = std::string("multipart/byteranges; boundary=") + boundary;
+        pResp->content_length = content_length;
+    }
+    range_index = 0;
+    range_offset = ranges[0].first;
+    // NOTE: stop reading until the ranges are sent, like HANDLE_CONTINUE
+    writer->stopRead();
+    return pResp->status_code;
+}
+
+int HttpHandler::sendFileWhole() {
+    ranges.clear();
+    range_boundary.clear();
+    if (fc->is_complete()) return 0;
+    // NOTE: not read for Range, stream the whole file as one range
+    long total = fc->st.st_size;
+    if (total == 0) return 0;
+    ranges.emplace_back(0, total - 1);
+    range_index = 0;
+    range_offset = 0;
+    resp->content = NULL;
+    resp->content_length = total;
+    writer->stopRead();
+    return resp->status_code;
+}
+
+std::string HttpHandler::rangePartHeader(long from, long to) {
+    return hv::asprintf("--%s\r\nContent-Type: %s\r\nContent-Range: bytes %ld-%ld/%ld\r\n\r\n",
+        range_boundary.c_str(), fc->content_type.c_str(), from, to, (long)fc->st.st_size);
+}
+
+void HttpHandler::sendFileRangeChunks() {
+    // NOTE: write may call onwrite at once, the loop below goes on then
+    if (range_writing) return;
+    range_writing = true;
+    bool multipart = !range_boundary.empty();
+    while (range_index < ranges.size() && hio_write_bufsize(writer->io()) == 0) {
+        long from = ranges[range_index].first, to = ranges[range_index].second;
+        // [part header] data [CRLF [close-delimiter]]
+        hbuf_t bufs[3];
+        int nbufs = 0;
+        std::string part_header, part_tail;
+        if (multipart && range_offset == from) {
+            part_header = rangePartHeader(from, to);
+            bufs[nbufs].base = (char*)part_header.data();
+            bufs[nbufs].len = part_header.size();
+            ++nbufs;
+        }
+        size_t len = MIN(to + 1 - range_offset, HTTP_RANGE_CHUNK_SIZE);
+        if (fc->is_complete()) {
+            bufs[nbufs].base = fc->filebuf.base + range_offset;
+        } else {
+            body.resize(len);
+            if (fc->read_range((char*)body.data(), range_offset, len) != (ssize_t)len) {
+                hloge("[%s:%d] read file range failed: %s", ip, port, fc->filepath.c_str());
+                // NOTE: header sent, close to tell client the body is incomplete
+                ranges.clear();
+                range_writing = false;
+                writer->close(true);
+                return;
+            }
+            bufs[nbufs].base = (char*)body.data();
+        }
+        bufs[nbufs].len = len;
+        ++nbufs;
+        range_offset += len;
+        if (range_offset > to) {
+            if (multipart) {
+                part_tail = ++range_index < ranges.size() ? "\r\n" : "\r\n--" + range_boundary + "--\r\n";
+                bufs[nbufs].base = (char*)part_tail.data();
+                bufs[nbufs].len = part_tail.size();
+                ++nbufs;
+            } else {
+                ++range_index;
+            }
+            if (range_index < ranges.size()) {
+                range_offset = ranges[range_index].first;
+            }
+        }
+        if (writer->writev(bufs, nbufs) < 0) break;
+    }
+    range_writing = false;
+    if (range_index < ranges.size()) return;
+    // all sent, SEND_DONE => clear
+    state = SEND_DONE;
+    char* data = NULL;
+    size_t len = 0;
+    GetSendData(&data, &len);
+    if (req->IsKeepAlive()) {
+        writer->startRead();
+    } else {
+        // NOTE: async, may be in write callback of io
+        writer->close(true);
+    }
+}
+
+int HttpHandler::SendHttpResponse() {
+    char* data = NULL;
+    size_t len = 0, total_len = 0;
+    // NOTE: gather HTTP/1 header and body into one writev
+    hbuf_t bufs[2];
+    int nbufs = 0;
+    while (GetSendData(&data, &len)) {
+        // printf("%.*s\n", (int)len, data);
+        if (data && len) {
+            if (protocol == HTTP_V1) {
+                bufs[nbufs].base = data;
+                bufs[nbufs].len = len;
+                ++nbufs;
+            } else {
+                writer->write(data, len);
+            }
+            total_len += len;
+        }
+        // NOTE: GetSendData in SEND_DONE state will clear header
+        if (nbufs == 2 || (nbufs && state == SEND_DONE)) {
+            writer->writev(bufs, nbufs);
+            nbufs = 0;
+        }
+    }
+    if (nbufs) {
+        writer->writev(bufs, nbufs);
+    }
+    if (state == SEND_BODY && !ranges.empty()) {
+        sendFileRangeChunks();
+    }
+    return total_len;
+}
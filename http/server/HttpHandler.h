@@ -1,6 +1,8 @@
 #ifndef HV_HTTP_HANDLER_H_
 #define HV_HTTP_HANDLER_H_
 
+#include "list.h"
+
 #include "HttpService.h"
 #include "HttpParser.h"
 #include "FileCache.h"
@@ -8,6 +10,23 @@
 #include "WebSocketServer.h"
 #include "WebSocketParser.h"
 
+#include "GrpcServer.h"
+
+#define HTTP_MAX_RANGES     16
+// pread and write ranges of uncached file by chunks of this size
+#define HTTP_RANGE_CHUNK_SIZE   (1 << 16)
+
+class HttpRateLimiter;
+class HttpOverloadMonitor;
+class HttpHandler;
+
+// node of keep-alive connections of a loop in order of last active
+struct http_idle_node {
+    struct list_node    node;
+    HttpHandler*        handler;
+    uint64_t            active_ms;
+};
+
 class WebSocketHandler {
 public:
     WebSocketChannelPtr         channel;
@@ -69,16 +88,44 @@ public:
     HttpResponsePtr         resp;
     HttpResponseWriterPtr   writer;
     HttpParserPtr           parser;
+    // reused by requests of this connection
+    HttpContextPtr          ctx;
 
     // for GetSendData
     file_cache_ptr          fc;
     std::string             header;
     std::string             body;
 
+    // for sendFileRanges, streamed by sendFileRangeChunks on write complete
+    std::vector<std::pair<long, long>>  ranges;
+    size_t                  range_index;
+    long                    range_offset;
+    // empty if single range, else multipart/byteranges
+    std::string             range_boundary;
+    bool                    range_writing;
+
+    // for HttpService::StreamBody and HttpService::Limit
+    // 0: continue, otherwise http_status_code returned by http_body_consumer,
+    // or HTTP_STATUS_TOO_MANY_REQUESTS by limiter
+    int                     abort_status;
+    // token buckets of current loop, NULL if unlimited
+    HttpRateLimiter*        limiter;
+    // lag of current loop, NULL if disabled
+    HttpOverloadMonitor*    overload;
+    bool                    keepalive_shortened;
+
+    // for HttpService::hibernate_timeout
+    http_idle_node          idle;
+    // parser, req, resp, ctx released until next request
+    bool                    hibernated;
+
     // for websocket
     WebSocketHandlerPtr         ws;
     WebSocketService*           ws_service;
 
+    // for grpc
+    GrpcService*                grpc_service;
+
     HttpHandler() {
         protocol = UNKNOWN;
         state = WANT_RECV;
@@ -86,9 +133,27 @@ public:
         service = NULL;
         files = NULL;
         ws_service = NULL;
+        grpc_service = NULL;
+        range_index = 0;
+        range_offset = 0;
+        range_writing = false;
+        abort_status = 0;
+        limiter = NULL;
+        overload = NULL;
+        keepalive_shortened = false;
+        list_init(&idle.node);
+        idle.handler = this;
+        idle.active_ms = 0;
+        hibernated = false;
     }
 
     ~HttpHandler() {
+        list_del(&idle.node);
+        // NOTE: break cycle req -> body_cb -> consumer -> ctx -> req
+        if (req) {
+            req->head_cb = NULL;
+            req->body_cb = NULL;
+        }
         if (writer) {
             writer->status = hv::SocketChannel::DISCONNECTED;
         }
@@ -109,9 +174,24 @@ public:
             resp->http_minor = 0;
         }
         parser->InitRequest(req.get());
+        if (http_version == 2) {
+            initHttp2();
+        }
+        if (http_version == 1) {
+            req->head_cb = [this](const http_headers& headers) {
+                onHeadersComplete();
+            };
+        }
         if (io) {
             writer.reset(new hv::HttpResponseWriter(io, resp));
             writer->status = hv::SocketChannel::CONNECTED;
+            if (http_version == 1) {
+                writer->onwrite = [this](hv::Buffer* buf) {
+                    if (state == SEND_BODY && !ranges.empty()) {
+                        sendFileRangeChunks();
+                    }
+                };
+            }
         }
         return true;
     }
@@ -122,17 +202,34 @@ public:
             return false;
         }
         protocol = HTTP_V2;
+        req->head_cb = NULL;
+        req->body_cb = NULL;
         req->http_major = 2;
         req->http_minor = 0;
         resp->http_major = 2;
         resp->http_minor = 0;
         parser->InitRequest(req.get());
+        initHttp2();
         return true;
     }
 
+    // Release per-request state of idle HTTP/1 connection,
+    // NOTE: writer is kept, it is the channel of io.
+    // @retval false if busy: response unfinished, request partial,
+    // or writer still referenced by handlers.
+    bool Hibernate();
+    // recreate per-request state on next request
+    void WakeUp() {
+        Init(1);
+        writer->response = resp;
+        writer->Begin();
+        state = WANT_RECV;
+        hibernated = false;
+    }
+
     void Reset() {
         state = WANT_RECV;
-        req->Reset();
+        // NOTE: req->Reset() by InitRequest
         resp->Reset();
         parser->InitRequest(req.get());
         if (writer) {
@@ -145,6 +242,10 @@ public:
     // @result: HttpRequest -> HttpResponse/file_cache_t
     int HandleHttpRequest();
     int GetSendData(char** data, size_t* len);
+    // while (GetSendData) -> write
+    int SendHttpResponse();
+    // push into HttpAccessLog ring of current loop, or hlogi if no ring
+    void AccessLog();
 
     // websocket
     WebSocketHandler* SwitchWebSocket() {
@@ -169,13 +270,47 @@ public:
             ws_service->onmessage(ws->channel, msg);
         }
     }
+    void WebSocketOnFragment(const char* data, size_t size, bool fin) {
+        if (ws_service && ws_service->onfragment) {
+            ws_service->onfragment(ws->channel, data, size, fin);
+        }
+    }
 
 private:
     int defaultRequestHandler();
     int defaultStaticHandler();
     int defaultErrorHandler();
+    int checkNotModified(int status_code);
+    // Range: => 206 body, multipart/byteranges if multi-ranges
+    // @retval 0 if Range ignored, else http_status_code
+    int sendFileRanges();
+    // Range ignored => 200, the whole file as one range if not read
+    int sendFileWhole();
+    // write chunks of ranges until write queue not empty or all sent
+    void sendFileRangeChunks();
+    std::string rangePartHeader(long from, long to);
+    int finishHttpRequest(int status_code);
+    // AsyncOpen -> onFileLoaded -> resumeHttpRequest
+    void onFileLoaded(const file_cache_ptr& fc, int error);
+    // finishHttpRequest -> SendHttpResponse
+    void resumeHttpRequest(int status_code);
     int customHttpHandler(const http_handler& handler);
     int invokeHttpHandler(const http_handler* handler);
+    const HttpContextPtr& getHttpContext();
+    // worker_pool -> resumeHttpRequest
+    int invokeBlockingHandler(const http_handler* handler);
+    // head_cb -> HttpRateLimiter::AllowRoute -> http_body_handler -> body_cb
+    void onHeadersComplete();
+    // @retval false if rejected by limiter
+    bool checkRateLimit(bool check_ip, bool check_route);
+    // @retval false if loop overloaded
+    bool checkOverload();
+    // HTTP/2 SETTINGS from service
+    void initHttp2();
+    // FeedRecvData -> PopRequest -> HandleHttpRequest for each completed stream
+    void handleHttp2Requests();
+    // HEADERS of application/grpc stream -> GrpcService::methods
+    bool onHttp2StreamHeaders(void* stream);
 };
 
 #endif // HV_HTTP_HANDLER_H_
@@ -0,0 +1,92 @@
+#include "HttpOverloadMonitor.h"
+
+#include "hbase.h"
+#include "htime.h"
+#include "hlog.h"
+#include "ThreadLocalStorage.h"
+
+static hv::ThreadLocalStorage s_monitor_tls;
+
+HttpOverloadMonitor::HttpOverloadMonitor(hv::HttpService* service, hloop_t* loop)
+    : service(service)
+    , loop(loop)
+    , level(NORMAL)
+{
+    last_hrtime = gethrtime_us();
+    last_busy_hrtime = hloop_busy_hrtime(loop);
+    timer = htimer_add(loop, onTimer, DEFAULT_OVERLOAD_CHECK_INTERVAL);
+    hevent_set_userdata(timer, this);
+}
+
+void HttpOverloadMonitor::onTimer(htimer_t* timer) {
+    HttpOverloadMonitor* monitor = (HttpOverloadMonitor*)hevent_userdata(timer);
+    monitor->check();
+}
+
+void HttpOverloadMonitor::check() {
+    uint64_t now_hrtime = gethrtime_us();
+    uint64_t busy_hrtime = hloop_busy_hrtime(loop);
+    uint64_t elapsed = now_hrtime - last_hrtime;
+    // NOTE: timer runs late if callbacks before it run long
+    int64_t lag_ms = ((int64_t)elapsed - DEFAULT_OVERLOAD_CHECK_INTERVAL * 1000) / 1000;
+    int busy = elapsed ? (busy_hrtime - last_busy_hrtime) * 100 / elapsed : 0;
+    last_hrtime = now_hrtime;
+    last_busy_hrtime = busy_hrtime;
+
+    // NOTE: back to a lower level below half of thresholds
+    int max_lag = service->overload_max_lag;
+    int max_busy = service->overload_max_busy;
+    auto exceeds = [lag_ms, busy, max_lag, max_busy](int times, int divisor) {
+        return (max_lag  > 0 && lag_ms * divisor > max_lag * times) ||
+               (max_busy > 0 && busy   * divisor > max_busy * times);
+    };
+    Level new_level = level;
+    if (exceeds(2, 1)) {
+        new_level = OVERLOADED;
+    } else if (exceeds(1, 1)) {
+        new_level = MAX(level, BUSY);
+    } else if (!exceeds(1, 2)) {
+        new_level = NORMAL;
+    } else if (!exceeds(2, 2)) {
+        new_level = MIN(level, BUSY);
+    }
+    if (new_level != level) {
+        hlogw("loop lag=%lldms busy=%d%% overload level %d => %d",
+            (long long)lag_ms, busy, (int)level, (int)new_level);
+        setLevel(new_level);
+    }
+}
+
+void HttpOverloadMonitor::setLevel(Level new_level) {
+    if (level == NORMAL) {
+        ++service->limit_stats->overloads;
+        for (auto listenio : listenios) {
+            hio_del(listenio, HV_READ);
+        }
+    } else if (new_level == NORMAL) {
+        for (auto listenio : listenios) {
+            hio_accept(listenio);
+        }
+    }
+    level = new_level;
+}
+
+HttpOverloadMonitor* HttpOverloadMonitor::Register(hv::HttpService* service, hloop_t* loop) {
+    if (service->overload_max_lag <= 0 && service->overload_max_busy <= 0) {
+        return NULL;
+    }
+    HttpOverloadMonitor* monitor = new HttpOverloadMonitor(service, loop);
+    s_monitor_tls.set(monitor);
+    return monitor;
+}
+
+void HttpOverloadMonitor::Unregister() {
+    HttpOverloadMonitor* monitor = ThreadMonitor();
+    if (monitor == NULL) return;
+    s_monitor_tls.set(NULL);
+    delete monitor;
+}
+
+HttpOverloadMonitor* HttpOverloadMonitor::ThreadMonitor() {
+    return (HttpOverloadMonitor*)s_monitor_tls.get();
+}
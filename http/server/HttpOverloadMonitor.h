@@ -0,0 +1,57 @@
+#ifndef HV_HTTP_OVERLOAD_MONITOR_H_
+#define HV_HTTP_OVERLOAD_MONITOR_H_
+
+#include <vector>
+
+#include "hloop.h"
+#include "HttpService.h"
+
+#define HTTP_SERVICE_UNAVAILABLE_RESPONSE \
+    "HTTP/1.1 503 Service Unavailable\r\n" \
+    "Content-Length: 0\r\n" \
+    "Connection: close\r\n" \
+    "Retry-After: 1\r\n\r\n"
+
+// Samples lag of one loop by a timer:
+// how late the timer runs, and how much time spent in callbacks.
+class HttpOverloadMonitor {
+public:
+    enum Level {
+        NORMAL,
+        // stop accepting, shorten keep-alive
+        BUSY,
+        // also reject new requests
+        OVERLOADED,
+    };
+
+    // NOTE: timer is freed with loop, so delete monitor after loop stopped
+    HttpOverloadMonitor(hv::HttpService* service, hloop_t* loop);
+
+    // paused while not NORMAL, so that other loops accept
+    void AddListener(hio_t* listenio) {
+        listenios.push_back(listenio);
+    }
+
+    Level GetLevel() { return level; }
+
+    // create monitor for current loop thread if service overload enabled
+    static HttpOverloadMonitor* Register(hv::HttpService* service, hloop_t* loop);
+    static void Unregister();
+    static HttpOverloadMonitor* ThreadMonitor();
+
+private:
+    static void onTimer(htimer_t* timer);
+    void check();
+    void setLevel(Level level);
+
+private:
+    hv::HttpService*        service;
+    hloop_t*                loop;
+    htimer_t*               timer;
+    std::vector<hio_t*>     listenios;
+    Level                   level;
+    uint64_t                last_hrtime;
+    uint64_t                last_busy_hrtime;
+};
+
+#endif // HV_HTTP_OVERLOAD_MONITOR_H_
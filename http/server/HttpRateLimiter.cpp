@@ -0,0 +1,104 @@
+#include "HttpRateLimiter.h"
+
+#include "hlog.h"
+#include "ThreadLocalStorage.h"
+
+static hv::ThreadLocalStorage s_limiter_tls;
+
+HttpRateLimiter::HttpRateLimiter(hv::HttpService* service)
+    : service(service)
+{
+}
+
+bool HttpRateLimiter::take(token_bucket& bucket, int rate, int burst, uint64_t now_ms, bool peek) {
+    if (bucket.last_ms == 0) {
+        // new bucket is full
+        bucket.tokens = burst;
+    } else if (now_ms > bucket.last_ms) {
+        bucket.tokens += (now_ms - bucket.last_ms) * rate / 1000.0;
+        if (bucket.tokens > burst) bucket.tokens = burst;
+    }
+    bucket.last_ms = now_ms;
+    if (bucket.tokens < 1) return false;
+    if (!peek) bucket.tokens -= 1;
+    return true;
+}
+
+token_bucket& HttpRateLimiter::ipBucket(const char* ip) {
+    auto iter = ip_buckets.find(ip);
+    if (iter != ip_buckets.end()) {
+        ip_lru.splice(ip_lru.begin(), ip_lru, iter->second);
+        return iter->second->second;
+    }
+    // NOTE: table full, evict the oldest one, reuse its node
+    if (ip_buckets.size() >= (size_t)MAX(service->limit_table_size, 1)) {
+        ip_buckets.erase(ip_lru.back().first);
+        ip_lru.splice(ip_lru.begin(), ip_lru, std::prev(ip_lru.end()));
+        ip_lru.front().first = ip;
+    } else {
+        ip_lru.emplace_front(ip, token_bucket());
+    }
+    token_bucket& bucket = ip_lru.front().second;
+    // new bucket is full, see take
+    bucket.tokens = 0;
+    bucket.last_ms = 0;
+    ip_buckets[ip_lru.front().first] = ip_lru.begin();
+    return bucket;
+}
+
+bool HttpRateLimiter::AllowConnection(const char* ip, uint64_t now_ms) {
+    if (service->limit_rate <= 0) return true;
+    auto iter = ip_buckets.find(ip);
+    if (iter == ip_buckets.end()) return true;
+    int burst = service->limit_burst > 0 ? service->limit_burst : service->limit_rate;
+    if (take(iter->second->second, service->limit_rate, burst, now_ms, true)) return true;
+    ++service->limit_stats->rejected_connections;
+    return false;
+}
+
+bool HttpRateLimiter::AllowRequest(const char* ip, uint64_t now_ms) {
+    if (service->limit_rate <= 0) return true;
+    int burst = service->limit_burst > 0 ? service->limit_burst : service->limit_rate;
+    if (take(ipBucket(ip), service->limit_rate, burst, now_ms)) return true;
+    ++service->limit_stats->rejected_requests;
+    return false;
+}
+
+bool HttpRateLimiter::AllowRoute(const char* url, uint64_t now_ms) {
+    if (service->limit_routes.size() == 0) return true;
+    // {base_url}/path?query
+    const char* s = url;
+    const char* b = service->base_url.c_str();
+    while (*s && *b && *s == *b) {++s;++b;}
+    if (*b != '\0') return true;
+    const char* e = s;
+    while (*e && *e != '?') ++e;
+
+    std::string path(s, e);
+    auto iter = service->limit_routes.find(path);
+    if (iter == service->limit_routes.end()) return true;
+    const http_rate_limit& limit = iter->second;
+    if (take(route_buckets[path], limit.rate, limit.burst, now_ms)) return true;
+    ++service->limit_stats->rejected_routes;
+    return false;
+}
+
+HttpRateLimiter* HttpRateLimiter::Register(hv::HttpService* service) {
+    if (service->limit_rate <= 0 && service->limit_routes.size() == 0) {
+        return NULL;
+    }
+    HttpRateLimiter* limiter = new HttpRateLimiter(service);
+    s_limiter_tls.set(limiter);
+    return limiter;
+}
+
+void HttpRateLimiter::Unregister() {
+    HttpRateLimiter* limiter = ThreadLimiter();
+    if (limiter == NULL) return;
+    s_limiter_tls.set(NULL);
+    delete limiter;
+}
+
+HttpRateLimiter* HttpRateLimiter::ThreadLimiter() {
+    return (HttpRateLimiter*)s_limiter_tls.get();
+}
@@ -0,0 +1,54 @@
+#ifndef HV_HTTP_RATE_LIMITER_H_
+#define HV_HTTP_RATE_LIMITER_H_
+
+#include <string>
+#include <list>
+#include <unordered_map>
+
+#include "HttpService.h"
+
+#define HTTP_TOO_MANY_REQUESTS_RESPONSE \
+    "HTTP/1.1 429 Too Many Requests\r\n" \
+    "Content-Length: 0\r\n" \
+    "Connection: close\r\n" \
+    "Retry-After: 1\r\n\r\n"
+
+struct token_bucket {
+    double      tokens;
+    uint64_t    last_ms;
+};
+
+// Token buckets of client ips and routes of one loop,
+// no lock as only accessed in its loop thread.
+// NOTE: so the limits are per loop thread.
+class HttpRateLimiter {
+public:
+    HttpRateLimiter(hv::HttpService* service);
+
+    // on accept: @retval false if no token left for ip, without taking one
+    bool AllowConnection(const char* ip, uint64_t now_ms);
+    // on request begin: take one token of ip
+    bool AllowRequest(const char* ip, uint64_t now_ms);
+    // on headers complete: take one token of route
+    bool AllowRoute(const char* url, uint64_t now_ms);
+
+    // create limiter for current loop thread if service limits enabled
+    static HttpRateLimiter* Register(hv::HttpService* service);
+    static void Unregister();
+    static HttpRateLimiter* ThreadLimiter();
+
+private:
+    bool take(token_bucket& bucket, int rate, int burst, uint64_t now_ms, bool peek = false);
+    // @return bucket of ip moved to front, the oldest one reused if table full
+    token_bucket& ipBucket(const char* ip);
+
+private:
+    typedef std::list<std::pair<std::string, token_bucket>> ip_bucket_list;
+    hv::HttpService*                                service;
+    // LRU of limit_table_size at most, most recently used at front
+    ip_bucket_list                                  ip_lru;
+    std::unordered_map<std::string, ip_bucket_list::iterator>   ip_buckets;
+    std::unordered_map<std::string, token_bucket>   route_buckets;
+};
+
+#endif // HV_HTTP_RATE_LIMITER_H_
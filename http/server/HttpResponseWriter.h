@@ -3,6 +3,7 @@
 
 #include "Channel.h"
 #include "HttpMessage.h"
+#include "http_content.h"
 
 namespace hv {
 
@@ -29,6 +30,7 @@ public:
     // Begin -> WriteStatus -> WriteHeader -> WriteBody -> End
     // Begin -> EndHeaders("Content-Length", content_length) -> WriteBody -> WriteBody -> ... -> End
     // Begin -> EndHeaders("Transfer-Encoding", "chunked") -> WriteChunked -> WriteChunked -> ... -> End
+    // Begin -> BeginEventStream -> WriteEvent -> WriteEvent -> ... -> End
 
     int Begin() {
         state = SEND_BEGIN;
@@ -53,11 +55,8 @@ public:
 
     int EndHeaders(const char* key = NULL, const char* value = NULL) {
         if (state != SEND_BEGIN) return -1;
-        if (key && value) {
-            response->headers[key] = value;
-        }
-        std::string headers = response->Dump(true, false);
-        state = SEND_HEADER;
+        std::string headers;
+        dumpHeaders(headers, key, value);
         return write(headers);
     }
 
@@ -67,23 +66,9 @@ public:
         return EndHeaders(key, value.c_str());
     }
 
+    // NOTE: one writev per chunk, with headers if not sent yet.
     int WriteChunked(const char* buf, int len = -1) {
-        int ret = 0;
-        if (len == -1) len = strlen(buf);
-        if (state == SEND_BEGIN) {
-            EndHeaders("Transfer-Encoding", "chunked");
-        }
-        char chunked_header[64];
-        int chunked_header_len = snprintf(chunked_header, sizeof(chunked_header), "%x\r\n", len);
-        write(chunked_header, chunked_header_len);
-        if (buf && len) {
-            ret = write(buf, len);
-            state = SEND_CHUNKED;
-        } else {
-            state = SEND_CHUNKED_END;
-        }
-        write("\r\n", 2);
-        return ret;
+        return writeChunked(buf, len, false);
     }
 
     int WriteChunked(const std::string& str) {
@@ -94,6 +79,38 @@ public:
         return WriteChunked(NULL, 0);
     }
 
+    // Server-Sent Events: text/event-stream ends with the connection,
+    // so events are written as is, one write per event, no chunked framing.
+    int BeginEventStream() {
+        if (state != SEND_BEGIN) return -1;
+        response->status_code = HTTP_STATUS_OK;
+        response->content_type = TEXT_EVENT_STREAM;
+        response->headers["Cache-Control"] = "no-cache";
+        response->headers["Connection"] = "close";
+        // NOTE: long-lived, judge alive by heartbeat comments
+        setKeepaliveTimeout(0);
+        int ret = EndHeaders();
+        state = SEND_BODY;
+        return ret;
+    }
+
+    int WriteEvent(const std::string& data, const char* event = NULL, const char* id = NULL) {
+        if (state == SEND_BEGIN) {
+            BeginEventStream();
+        }
+        std::string msg;
+        dump_sse_event(msg, data.data(), data.size(), event, id);
+        return write(msg);
+    }
+
+    // event encoded once by dump_sse_event, shared by subscribers
+    int WriteEvent(const BufferPtr& frame) {
+        if (state == SEND_BEGIN) {
+            BeginEventStream();
+        }
+        return write(frame->data(), frame->size());
+    }
+
     int WriteBody(const char* buf, int len = -1) {
         if (response->IsChunked()) {
             return WriteChunked(buf, len);
@@ -133,12 +150,8 @@ public:
 
         int ret = 0;
         if (state == SEND_CHUNKED) {
-            if (buf) {
-                ret = WriteChunked(buf, len);
-            }
-            if (state == SEND_CHUNKED) {
-                EndChunked();
-            }
+            // last chunk and end chunk in one writev
+            ret = writeChunked(buf, len, true);
         } else {
             if (buf) {
                 ret = WriteBody(buf, len);
@@ -159,7 +172,8 @@ public:
 
         state = SEND_END;
         if (!response->IsKeepAlive()) {
-            close();
+            // NOTE: End may be called in the handler, which close_cb deletes
+            close(true);
         }
         return ret;
     }
@@ -167,6 +181,46 @@ public:
     int End(const std::string& str) {
         return End(str.c_str(), str.size());
     }
+
+private:
+    void dumpHeaders(std::string& str, const char* key = NULL, const char* value = NULL) {
+        if (key && value) {
+            response->headers[key] = value;
+        }
+        response->Dump(str, true, false);
+        state = SEND_HEADER;
+    }
+
+    // [headers] chunk-size CRLF chunk-data CRLF [0 CRLF CRLF]
+    int writeChunked(const char* buf, int len, bool last) {
+        if (buf == NULL) len = 0;
+        else if (len == -1) len = strlen(buf);
+        std::string headers;
+        if (state == SEND_BEGIN) {
+            dumpHeaders(headers, "Transfer-Encoding", "chunked");
+        }
+        char chunked_header[64];
+        hbuf_t bufs[5];
+        int nbufs = 0;
+        if (!headers.empty()) {
+            bufs[nbufs++] = hbuf_t((void*)headers.data(), headers.size());
+        }
+        if (len > 0) {
+            int chunked_header_len = snprintf(chunked_header, sizeof(chunked_header), "%x\r\n", len);
+            bufs[nbufs++] = hbuf_t(chunked_header, chunked_header_len);
+            bufs[nbufs++] = hbuf_t((void*)buf, len);
+            bufs[nbufs++] = hbuf_t((void*)"\r\n", 2);
+            state = SEND_CHUNKED;
+        } else {
+            last = true;
+        }
+        if (last) {
+            bufs[nbufs++] = hbuf_t((void*)"0\r\n\r\n", 5);
+            state = SEND_CHUNKED_END;
+        }
+        int nwrite = writev(bufs, nbufs);
+        return nwrite < 0 ? nwrite : len;
+    }
 };
 
 }
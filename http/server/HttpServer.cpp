@@ -9,9 +9,13 @@
 #include "wsdef.h"
 
 #include "EventLoop.h"
+#include "ThreadLocalStorage.h"
 using namespace hv;
 
 #include "HttpHandler.h"
+#include "HttpAccessLog.h"
+#include "HttpRateLimiter.h"
+#include "HttpOverloadMonitor.h"
 
 #define MIN_HTTP_REQUEST        "GET / HTTP/1.1\r\n\r\n"
 #define MIN_HTTP_REQUEST_LEN    14 // exclude CRLF
@@ -30,6 +34,43 @@ static FileCache* default_filecache() {
     return &s_filecache;
 }
 
+// HTTP/1 connections of a loop in order of last active
+struct http_idle_list {
+    struct list_head    head;
+    HttpService*        service;
+};
+static hv::ThreadLocalStorage s_idle_list_tls;
+
+static void idle_list_touch(hio_t* io, HttpHandler* handler) {
+    if (handler->hibernated) {
+        handler->WakeUp();
+    }
+    http_idle_list* idle_list = (http_idle_list*)s_idle_list_tls.get();
+    if (idle_list == NULL) return;
+    if (handler->protocol != HttpHandler::UNKNOWN && handler->protocol != HttpHandler::HTTP_V1) return;
+    list_del(&handler->idle.node);
+    list_add_tail(&handler->idle.node, &idle_list->head);
+    handler->idle.active_ms = hloop_now_ms(hevent_loop(io));
+}
+
+static void idle_list_sweep(htimer_t* timer) {
+    http_idle_list* idle_list = (http_idle_list*)hevent_userdata(timer);
+    uint64_t now_ms = hloop_now_ms(hevent_loop(timer));
+    uint64_t timeout = idle_list->service->hibernate_timeout;
+    while (!list_empty(&idle_list->head)) {
+        http_idle_node* idle = list_first_entry(&idle_list->head, http_idle_node, node);
+        if (idle->active_ms + timeout > now_ms) break;
+        list_del_init(&idle->node);
+        // NOTE: upgraded connections are not HTTP/1 any more
+        if (idle->handler->protocol != HttpHandler::HTTP_V1) continue;
+        if (!idle->handler->Hibernate()) {
+            // busy, check later
+            idle->active_ms = now_ms;
+            list_add_tail(&idle->node, &idle_list->head);
+        }
+    }
+}
+
 struct HttpServerPrivdata {
     std::vector<EventLoopPtr>   loops;
     std::vector<hthread_t>      threads;
@@ -81,6 +122,9 @@ static void on_recv(hio_t* io, void* _buf, int readbytes) {
     HttpHandler* handler = (HttpHandler*)hevent_userdata(io);
     assert(handler != NULL);
 
+    // NOTE: recreate per-request state if hibernated
+    idle_list_touch(io, handler);
+
     // HttpHandler::Init(http_version) -> upgrade ? SwitchHTTP2 / SwitchWebSocket
     // on_recv -> FeedRecvData -> HttpRequest
     // onComplete -> HandleRequest -> HttpResponse -> while (GetSendData) -> send
@@ -117,10 +161,26 @@ static void on_recv(hio_t* io, void* _buf, int readbytes) {
         return;
     }
 
+    // NOTE: shorten keep-alive while loop busy, so idle connections are released sooner
+    if (handler->overload && protocol != HttpHandler::WEBSOCKET) {
+        bool shorten = handler->overload->GetLevel() != HttpOverloadMonitor::NORMAL;
+        if (shorten != handler->keepalive_shortened) {
+            handler->keepalive_shortened = shorten;
+            HttpService* service = handler->service;
+            hio_set_keepalive_timeout(io, shorten ? service->overload_keepalive_timeout : service->keepalive_timeout);
+        }
+    }
+
     if (protocol == HttpHandler::WEBSOCKET) {
         return;
     }
 
+    if (handler->protocol == HttpHandler::HTTP_V2) {
+        // NOTE: requests of completed streams have been handled in FeedRecvData
+        handler->SendHttpResponse();
+        return;
+    }
+
     HttpParser* parser = handler->parser.get();
     if (parser->WantRecv()) {
         return;
@@ -129,24 +189,15 @@ static void on_recv(hio_t* io, void* _buf, int readbytes) {
     HttpRequest* req = handler->req.get();
     HttpResponse* resp = handler->resp.get();
 
-    // Server:
-    static char s_Server[64] = {'\0'};
-    if (s_Server[0] == '\0') {
-        snprintf(s_Server, sizeof(s_Server), "httpd/%s", hv_compile_version());
-    }
-    resp->headers["Server"] = s_Server;
-
-    // Connection:
+    // Server: Connection: rendered by HttpResponse::Dump
     bool keepalive = req->IsKeepAlive();
-    if (keepalive) {
-        resp->headers["Connection"] = "keep-alive";
-    } else {
-        resp->headers["Connection"] = "close";
-    }
+    resp->static_headers = HttpResponse::STATIC_HEADER_SERVER |
+        (keepalive ? HttpResponse::STATIC_HEADER_KEEPALIVE : HttpResponse::STATIC_HEADER_CLOSE);
 
     // Upgrade:
     bool upgrade = false;
     HttpHandler::ProtocolType upgrade_protocol = HttpHandler::UNKNOWN;
+    WebSocketDeflatePtr ws_deflate;
     auto iter_upgrade = req->headers.find("upgrade");
     if (iter_upgrade != req->headers.end()) {
         upgrade = true;
@@ -169,6 +220,17 @@ static void on_recv(hio_t* io, void* _buf, int readbytes) {
                 ws_encode_key(iter_key->second.c_str(), ws_accept);
                 resp->headers[SEC_WEBSOCKET_ACCEPT] = ws_accept;
             }
+            // Sec-WebSocket-Extensions: permessage-deflate
+            WebSocketService* ws_service = handler->ws_service;
+            auto iter_extensions = req->headers.find(SEC_WEBSOCKET_EXTENSIONS);
+            if (ws_service && ws_service->permessage_deflate && iter_extensions != req->headers.end()) {
+                WebSocketDeflatePtr deflate(new WebSocketDeflate(WS_SERVER, ws_service->deflate_options));
+                std::string extensions;
+                if (deflate->Negotiate(iter_extensions->second.c_str(), extensions) == 0) {
+                    resp->headers[SEC_WEBSOCKET_EXTENSIONS] = extensions;
+                    ws_deflate = deflate;
+                }
+            }
             upgrade_protocol = HttpHandler::WEBSOCKET;
         }
         // h2/h2c
@@ -197,28 +259,28 @@ static void on_recv(hio_t* io, void* _buf, int readbytes) {
         status_code = handler->HandleHttpRequest();
     }
 
-    char* data = NULL;
-    size_t len = 0;
-    while (handler->GetSendData(&data, &len)) {
-        // printf("%.*s\n", (int)len, data);
-        if (data && len) {
-            hio_write(io, data, len);
-        }
-    }
+    handler->SendHttpResponse();
 
     // LOG
-    hloop_t* loop = hevent_loop(io);
-    hlogi("[%ld-%ld][%s:%d][%s %s]=>[%d %s]",
-        hloop_pid(loop), hloop_tid(loop),
-        handler->ip, handler->port,
-        http_method_str(req->method), req->path.c_str(),
-        resp->status_code, resp->status_message());
+    if (handler->state != HttpHandler::HANDLE_CONTINUE) {
+        handler->AccessLog();
+    }
 
     // switch protocol to websocket
     if (upgrade && upgrade_protocol == HttpHandler::WEBSOCKET) {
         WebSocketHandler* ws = handler->SwitchWebSocket();
         ws->Init(io);
         ws->parser->onMessage = std::bind(websocket_onmessage, std::placeholders::_1, std::placeholders::_2, io);
+        ws->parser->deflate = ws_deflate;
+        ws->channel->deflate = ws_deflate;
+        if (handler->ws_service) {
+            ws->parser->max_message_size = handler->ws_service->max_message_size;
+            if (handler->ws_service->onfragment) {
+                ws->parser->onFragment = [handler](int opcode, const char* data, size_t size, bool fin) {
+                    handler->WebSocketOnFragment(data, size, fin);
+                };
+            }
+        }
         // NOTE: cancel keepalive timer, judge alive by heartbeat.
         hio_set_keepalive_timeout(io, 0);
         if (handler->ws_service && handler->ws_service->ping_interval > 0) {
@@ -230,7 +292,8 @@ static void on_recv(hio_t* io, void* _buf, int readbytes) {
         return;
     }
 
-    if (status_code && !keepalive) {
+    // NOTE: closed by sendFileRangeChunks if sending ranges
+    if (status_code && !keepalive && handler->state != HttpHandler::SEND_BODY) {
         hio_close(io);
     }
 }
@@ -259,6 +322,17 @@ static void on_accept(hio_t* io) {
             SOCKADDR_STR(hio_peeraddr(io), peeraddrstr));
     */
 
+    // NOTE: close at once if the client has no token left
+    HttpRateLimiter* limiter = HttpRateLimiter::ThreadLimiter();
+    if (limiter) {
+        char ip[64];
+        sockaddr_ip((sockaddr_u*)hio_peeraddr(io), ip, sizeof(ip));
+        if (!limiter->AllowConnection(ip, hloop_now_ms(hevent_loop(io)))) {
+            hio_close(io);
+            return;
+        }
+    }
+
     hio_setcb_close(io, on_close);
     hio_setcb_read(io, on_recv);
     hio_read(io);
@@ -276,8 +350,14 @@ static void on_accept(hio_t* io) {
     handler->service = service;
     // ws
     handler->ws_service = server->ws;
+    // grpc
+    handler->grpc_service = server->grpc;
     // FileCache
     handler->files = default_filecache();
+    // limiter
+    handler->limiter = limiter;
+    // overload
+    handler->overload = HttpOverloadMonitor::ThreadMonitor();
     hevent_set_userdata(io, handler);
 }
 
@@ -286,26 +366,49 @@ static void loop_thread(void* userdata) {
 
     EventLoopPtr loop(new EventLoop);
     hloop_t* hloop = loop->loop();
+    // NOTE: stop accepting on this loop if overloaded, let other loops accept
+    HttpOverloadMonitor* overload = HttpOverloadMonitor::Register(server->service, hloop);
     // http
     if (server->listenfd[0] >= 0) {
         hio_t* listenio = haccept(hloop, server->listenfd[0], on_accept);
         hevent_set_userdata(listenio, server);
+        if (overload) overload->AddListener(listenio);
     }
     // https
     if (server->listenfd[1] >= 0) {
         hio_t* listenio = haccept(hloop, server->listenfd[1], on_accept);
         hevent_set_userdata(listenio, server);
         hio_enable_ssl(listenio);
+        if (overload) overload->AddListener(listenio);
+    }
+
+    // NOTE: access log and hlog are fsynced by HttpAccessLog thread
+    HttpService* service = server->service;
+    if (service->access_log) {
+        HttpAccessLog::instance()->Register(service->access_log_file.c_str(), service->access_log_sample);
+    }
+    // NOTE: token buckets are loop-local, no lock
+    HttpRateLimiter::Register(service);
+    // NOTE: hibernate idle keep-alive connections
+    http_idle_list idle_list;
+    list_init(&idle_list.head);
+    idle_list.service = service;
+    if (service->hibernate_timeout > 0) {
+        s_idle_list_tls.set(&idle_list);
+        htimer_t* timer = htimer_add(hloop, idle_list_sweep, service->hibernate_timeout);
+        hevent_set_userdata(timer, &idle_list);
     }
 
     HttpServerPrivdata* privdata = (HttpServerPrivdata*)server->privdata;
     privdata->mutex_.lock();
     if (privdata->loops.size() == 0) {
-        // NOTE: fsync logfile when idle
         hlog_disable_fsync();
-        hidle_add(hloop, [](hidle_t*) {
-            hlog_fsync();
-        }, INFINITE);
+        if (!service->access_log) {
+            // NOTE: fsync logfile when idle
+            hidle_add(hloop, [](hidle_t*) {
+                hlog_fsync();
+            }, INFINITE);
+        }
         // NOTE: add timer to remove expired file cache
         htimer_add(hloop, [](htimer_t*) {
             FileCache* filecache = default_filecache();
@@ -320,6 +423,13 @@ static void loop_thread(void* userdata) {
     privdata->mutex_.unlock();
 
     loop->run();
+
+    if (service->access_log) {
+        HttpAccessLog::instance()->Unregister();
+    }
+    HttpRateLimiter::Unregister();
+    HttpOverloadMonitor::Unregister();
+    s_idle_list_tls.set(NULL);
 }
 
 int http_server_run(http_server_t* server, int wait) {
@@ -339,6 +449,10 @@ int http_server_run(http_server_t* server, int wait) {
     if (server->service == NULL) {
         server->service = default_http_service();
     }
+    // Server:
+    if (HttpResponse::s_server[0] == '\0') {
+        snprintf(HttpResponse::s_server, sizeof(HttpResponse::s_server), "httpd/%s", hv_compile_version());
+    }
 
     HttpServerPrivdata* privdata = new HttpServerPrivdata;
     server->privdata = privdata;
@@ -6,9 +6,11 @@
 // #include "WebSocketServer.h"
 namespace hv {
 struct WebSocketService;
+struct GrpcService;
 }
 using hv::HttpService;
 using hv::WebSocketService;
+using hv::GrpcService;
 
 typedef struct http_server_s {
     char host[64];
@@ -19,6 +21,7 @@ typedef struct http_server_s {
     int worker_threads;
     HttpService* service;
     WebSocketService* ws;
+    GrpcService* grpc;
     void* userdata;
 //private:
     int listenfd[2]; // 0: http, 1: https
@@ -37,6 +40,7 @@ typedef struct http_server_s {
         worker_threads = 0;
         service = NULL;
         ws = NULL;
+        grpc = NULL;
         listenfd[0] = listenfd[1] = -1;
         userdata = NULL;
         privdata = NULL;
@@ -1,6 +1,7 @@
 #include "HttpService.h"
 
 #include "hbase.h" // import strendswith
+#include "HttpEventStream.h"
 
 namespace hv {
 
@@ -26,6 +27,37 @@ void HttpService::AddApi(const char* path, http_method method, const http_handle
     method_handlers->push_back(http_method_handler(method, handler));
 }
 
+void HttpService::Blocking(const char* relativePath, const char* httpMethod) {
+    auto iter = api_handlers.find(relativePath);
+    if (iter == api_handlers.end()) return;
+    http_method method = httpMethod ? http_method_enum(httpMethod) : HTTP_CUSTOM_METHOD;
+    for (auto& method_handler : *iter->second) {
+        if (httpMethod == NULL || method_handler.method == method) {
+            method_handler.handler.is_blocking = true;
+        }
+    }
+    if (worker_pool == NULL) {
+        worker_pool.reset(new HttpWorkerPool(worker_pool_threads, worker_pool_queue_size));
+    }
+}
+
+void HttpService::StreamBody(const char* relativePath, http_body_handler handlerFunc, const char* httpMethod) {
+    auto iter = api_handlers.find(relativePath);
+    if (iter == api_handlers.end()) return;
+    http_method method = httpMethod ? http_method_enum(httpMethod) : HTTP_CUSTOM_METHOD;
+    for (auto& method_handler : *iter->second) {
+        if (httpMethod == NULL || method_handler.method == method) {
+            method_handler.handler.body_handler = handlerFunc;
+        }
+    }
+}
+
+void HttpService::EventStream(const char* relativePath, HttpEventStream* stream) {
+    GET(relativePath, http_async_handler([stream](const HttpRequestPtr& req, const HttpResponseWriterPtr& writer) {
+        stream->Subscribe(req, writer);
+    }));
+}
+
 int HttpService::GetApi(const char* url, http_method method, http_handler** handler) {
     // {base_url}/path?query
     const char* s = url;
@@ -6,12 +6,15 @@
 #include <unordered_map>
 #include <list>
 #include <memory>
+#include <atomic>
 #include <functional>
 
 #include "hexport.h"
 #include "HttpMessage.h"
+#include "http2def.h"
 #include "HttpResponseWriter.h"
 #include "HttpContext.h"
+#include "HttpWorkerPool.h"
 
 #define DEFAULT_BASE_URL        "/api/v1"
 #define DEFAULT_DOCUMENT_ROOT   "/var/www/html"
@@ -19,6 +22,10 @@
 #define DEFAULT_ERROR_PAGE      "error.html"
 #define DEFAULT_INDEXOF_DIR     "/downloads/"
 #define DEFAULT_KEEPALIVE_TIMEOUT   75000   // ms
+#define DEFAULT_HIBERNATE_TIMEOUT   1000    // ms, suggested, hibernate_timeout is 0 by default
+#define DEFAULT_LIMIT_TABLE_SIZE    65536   // ip buckets per loop
+#define DEFAULT_OVERLOAD_CHECK_INTERVAL     100     // ms
+#define DEFAULT_OVERLOAD_KEEPALIVE_TIMEOUT  5000    // ms
 
 /*
  * @param[in]  req:  parsed structured http request
@@ -31,19 +38,37 @@ typedef std::function<int(HttpRequest* req, HttpResponse* resp)>
 typedef std::function<void(const HttpRequestPtr& req, const HttpResponseWriterPtr& writer)> http_async_handler;
 typedef std::function<int(const HttpContextPtr& ctx)>                                       http_ctx_handler;
 
+/*
+ * streaming request body, see HttpService::StreamBody
+ * @param[in] data, size: chunk of request body
+ * @return  0:                  continue
+ *          http_status_code:   abort, respond it and close connection
+ * NOTE: called in loop thread, call ctx->writer->stopRead() to pause reading
+ *       if consumer is slow, and startRead() in loop thread to resume.
+ */
+typedef std::function<int(const char* data, size_t size)>                                   http_body_consumer;
+// called on request headers complete, return NULL to buffer body as usual.
+typedef std::function<http_body_consumer(const HttpContextPtr& ctx)>                        http_body_handler;
+
 struct http_handler {
     http_sync_handler   sync_handler;
     http_async_handler  async_handler;
     http_ctx_handler    ctx_handler;
-
-    http_handler()  {}
-    http_handler(http_sync_handler fn)  : sync_handler(std::move(fn))   {}
-    http_handler(http_async_handler fn) : async_handler(std::move(fn))  {}
-    http_handler(http_ctx_handler fn)   : ctx_handler(std::move(fn))    {}
+    // consume request body as it arrives, instead of buffering into req->body
+    http_body_handler   body_handler;
+    // run in HttpService::worker_pool instead of loop thread
+    bool                is_blocking;
+
+    http_handler()                      : is_blocking(false) {}
+    http_handler(http_sync_handler fn)  : sync_handler(std::move(fn)),  is_blocking(false) {}
+    http_handler(http_async_handler fn) : async_handler(std::move(fn)), is_blocking(false) {}
+    http_handler(http_ctx_handler fn)   : ctx_handler(std::move(fn)),   is_blocking(false) {}
     http_handler(const http_handler& rhs)
         : sync_handler(std::move(rhs.sync_handler))
         , async_handler(std::move(rhs.async_handler))
         , ctx_handler(std::move(rhs.ctx_handler))
+        , body_handler(std::move(rhs.body_handler))
+        , is_blocking(rhs.is_blocking)
     {}
 
     const http_handler& operator=(http_sync_handler fn) {
@@ -83,8 +108,30 @@ typedef std::list<http_method_handler>
 // path => http_method_handlers
 typedef std::unordered_map<std::string, std::shared_ptr<http_method_handlers>>  http_api_handlers;
 
+// token bucket: rate tokens per second, at most burst tokens
+struct http_rate_limit {
+    int rate;
+    int burst;
+};
+
+// counters of rejected, shared by all loops
+struct http_limit_stats {
+    std::atomic<uint64_t>   rejected_connections;
+    std::atomic<uint64_t>   rejected_requests;
+    std::atomic<uint64_t>   rejected_routes;
+    // by overload shedding
+    std::atomic<uint64_t>   overloads;
+    std::atomic<uint64_t>   shed_requests;
+
+    http_limit_stats()
+        : rejected_connections(0), rejected_requests(0), rejected_routes(0)
+        , overloads(0), shed_requests(0) {}
+};
+
 namespace hv {
 
+class HttpEventStream;
+
 struct HV_EXPORT HttpService {
     // preprocessor -> processor -> postprocessor
     http_handler        preprocessor;
@@ -109,6 +156,42 @@ struct HV_EXPORT HttpService {
 
     // options
     int keepalive_timeout;
+    // release per-request state of HTTP/1 connections idle for hibernate_timeout,
+    // recreated on next request. 0 means never, by default.
+    int hibernate_timeout;
+    // load uncached static files in FileCache threads instead of loop thread
+    bool async_file_load;
+    // mmap static files instead of reading them into heap,
+    // so that worker processes share the same page cache.
+    bool file_cache_mmap;
+    // access log, formatted and written by a background thread
+    bool access_log;
+    // empty means write into hlog
+    std::string access_log_file;
+    // log 1 of every access_log_sample successful requests
+    int access_log_sample;
+    // worker pool for Blocking handlers, created by Blocking
+    int worker_pool_threads;
+    int worker_pool_queue_size;
+    std::shared_ptr<HttpWorkerPool> worker_pool;
+    // SETTINGS of HTTP/2 connections
+    int http2_max_concurrent_streams;
+    int http2_initial_window_size;
+    // token bucket per client ip, checked before parsing the request,
+    // respond 429 and close if no token left. 0 means unlimited.
+    int limit_rate;
+    int limit_burst;
+    int limit_table_size;
+    // path => token bucket shared by clients, set by Limit
+    std::map<std::string, http_rate_limit> limit_routes;
+    std::shared_ptr<http_limit_stats> limit_stats;
+    // overload shedding by lag of each loop, 0 means disabled.
+    // timer lag > overload_max_lag ms or callbacks > overload_max_busy percent of time:
+    // stop accepting and shorten keep-alive to overload_keepalive_timeout;
+    // twice of them: also respond 503 and close to new requests.
+    int overload_max_lag;
+    int overload_max_busy;
+    int overload_keepalive_timeout;
 
     HttpService() {
         // base_url = DEFAULT_BASE_URL;
@@ -119,6 +202,22 @@ struct HV_EXPORT HttpService {
         // index_of = DEFAULT_INDEXOF_DIR;
 
         keepalive_timeout = DEFAULT_KEEPALIVE_TIMEOUT;
+        hibernate_timeout = 0;
+        async_file_load = false;
+        file_cache_mmap = false;
+        access_log = true;
+        access_log_sample = 1;
+        worker_pool_threads = DEFAULT_WORKER_POOL_THREADS;
+        worker_pool_queue_size = DEFAULT_WORKER_POOL_QUEUE_SIZE;
+        http2_max_concurrent_streams = DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS;
+        http2_initial_window_size = DEFAULT_HTTP2_INITIAL_WINDOW_SIZE;
+        limit_rate = 0;
+        limit_burst = 0;
+        limit_table_size = DEFAULT_LIMIT_TABLE_SIZE;
+        limit_stats.reset(new http_limit_stats);
+        overload_max_lag = 0;
+        overload_max_busy = 0;
+        overload_keepalive_timeout = DEFAULT_OVERLOAD_KEEPALIVE_TIMEOUT;
     }
 
     // @retval 0 OK, else HTTP_STATUS_NOT_FOUND, HTTP_STATUS_METHOD_NOT_ALLOWED
@@ -127,6 +226,35 @@ struct HV_EXPORT HttpService {
     // RESTful API /:field/ => req->query_params["field"]
     int  GetApi(HttpRequest* req, http_handler** handler);
 
+    // Run handlers of relativePath in worker_pool, the response is sent
+    // back in loop thread. If worker_pool is full, respond 503.
+    // NOTE: call after registering the handlers.
+    // service.GET("/query", query_db);
+    // service.Blocking("/query");
+    void Blocking(const char* relativePath, const char* httpMethod = NULL);
+
+    // Stream request body of relativePath to the consumer created by handlerFunc,
+    // then handlers registered by GET/POST/... are called with empty req->body.
+    // NOTE: call after registering the handlers.
+    // service.POST("/upload", upload_done);
+    // service.StreamBody("/upload", upload_stream);
+    void StreamBody(const char* relativePath, http_body_handler handlerFunc, const char* httpMethod = NULL);
+
+    // Server-Sent Events: GET relativePath subscribes to stream,
+    // resuming from Last-Event-ID, see HttpEventStream.
+    // service.EventStream("/events", &stream);
+    void EventStream(const char* relativePath, HttpEventStream* stream);
+
+    // Limit requests of relativePath to rate per second with burst,
+    // checked after request headers parsed, respond 429 if exceeded.
+    // NOTE: the buckets are per loop thread.
+    // service.Limit("/login", 10, 20);
+    void Limit(const char* relativePath, int rate, int burst = 0) {
+        http_rate_limit& limit = limit_routes[relativePath];
+        limit.rate = rate;
+        limit.burst = burst > 0 ? burst : rate;
+    }
+
     hv::StringList Paths() {
         hv::StringList paths;
         for (auto& pair : api_handlers) {
@@ -0,0 +1,90 @@
+#ifndef HV_HTTP_WORKER_POOL_H_
+#define HV_HTTP_WORKER_POOL_H_
+
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+#include "hexport.h"
+#include "htime.h"
+#include "hthreadpool.h"
+
+#define DEFAULT_WORKER_POOL_THREADS     8
+#define DEFAULT_WORKER_POOL_QUEUE_SIZE  1024
+
+namespace hv {
+
+// Bounded thread pool for blocking http handlers.
+// NOTE: threads are started on first Post, so that forked worker processes
+// own their threads.
+class HttpWorkerPool {
+public:
+    typedef std::function<void()> Task;
+
+    HttpWorkerPool(int threads = DEFAULT_WORKER_POOL_THREADS, int queue_size = DEFAULT_WORKER_POOL_QUEUE_SIZE)
+        : max_queue_size(queue_size)
+        , pool(threads)
+    {
+        total_num = 0;
+        started_num = 0;
+        reject_num = 0;
+        queue_time_us = 0;
+        max_queue_time_us = 0;
+    }
+
+    // @retval false if queue is full
+    bool Post(Task task) {
+        if (pool.status == HThreadPool::STOP) {
+            std::lock_guard<std::mutex> locker(mutex_);
+            pool.start();
+        }
+        if (max_queue_size > 0 && QueueSize() >= max_queue_size) {
+            ++reject_num;
+            return false;
+        }
+        uint64_t post_time = gethrtime_us();
+        pool.commit([this, task, post_time]() {
+            uint64_t queue_time = gethrtime_us() - post_time;
+            queue_time_us += queue_time;
+            ++started_num;
+            uint64_t max_time = max_queue_time_us;
+            while (queue_time > max_time &&
+                   !max_queue_time_us.compare_exchange_weak(max_time, queue_time));
+            task();
+        });
+        ++total_num;
+        return true;
+    }
+
+    int QueueSize() {
+        return pool.taskNum();
+    }
+
+    int IdleThreadNum() {
+        return pool.idle_num;
+    }
+
+    // average time-in-queue of started tasks
+    // NOTE: not of total_num, tasks still queued have no queue time summed yet.
+    uint64_t AvgQueueTimeUs() {
+        uint64_t num = started_num;
+        return num == 0 ? 0 : queue_time_us / num;
+    }
+
+public:
+    int                     max_queue_size;
+    // metrics
+    std::atomic<uint64_t>   total_num;
+    std::atomic<uint64_t>   started_num;
+    std::atomic<uint64_t>   reject_num;
+    std::atomic<uint64_t>   queue_time_us;
+    std::atomic<uint64_t>   max_queue_time_us;
+
+private:
+    HThreadPool             pool;
+    std::mutex              mutex_;
+};
+
+}
+
+#endif // HV_HTTP_WORKER_POOL_H_
@@ -0,0 +1,64 @@
+#include "WebSocketServer.h"
+
+#include <unordered_map>
+
+#include "hthread.h"
+
+namespace hv {
+
+// channels of one loop to send the same frame
+struct WebSocketBroadcast {
+    BufferPtr                           frame;
+    std::vector<WebSocketChannelPtr>    channels;
+};
+
+static void broadcast_in_loop(WebSocketBroadcast* batch) {
+    for (auto& channel : batch->channels) {
+        channel->sendFrame(batch->frame);
+    }
+}
+
+static void on_broadcast(hevent_t* ev) {
+    WebSocketBroadcast* batch = (WebSocketBroadcast*)hevent_userdata(ev);
+    broadcast_in_loop(batch);
+    delete batch;
+}
+
+int WebSocketService::broadcast(const std::vector<WebSocketChannelPtr>& channels,
+                                const char* buf, int len, enum ws_opcode opcode) {
+    if (channels.empty()) return 0;
+    return broadcast(channels, WebSocketChannel::buildServerFrame(buf, len, opcode));
+}
+
+int WebSocketService::broadcast(const std::vector<WebSocketChannelPtr>& channels, const BufferPtr& frame) {
+    std::unordered_map<hloop_t*, WebSocketBroadcast*> batches;
+    for (auto& channel : channels) {
+        if (!channel || !channel->isOpened()) continue;
+        hloop_t* loop = hevent_loop(channel->io());
+        WebSocketBroadcast*& batch = batches[loop];
+        if (batch == NULL) {
+            batch = new WebSocketBroadcast;
+            batch->frame = frame;
+        }
+        batch->channels.push_back(channel);
+    }
+    int nchannels = 0;
+    for (auto& pair : batches) {
+        hloop_t* loop = pair.first;
+        WebSocketBroadcast* batch = pair.second;
+        nchannels += batch->channels.size();
+        if (hloop_tid(loop) == hv_gettid()) {
+            broadcast_in_loop(batch);
+            delete batch;
+            continue;
+        }
+        hevent_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.cb = on_broadcast;
+        ev.userdata = batch;
+        hloop_post_event(loop, &ev);
+    }
+    return nchannels;
+}
+
+}
@@ -14,15 +14,38 @@
 
 namespace hv {
 
-struct WebSocketService {
+struct HV_EXPORT WebSocketService {
     std::function<void(const WebSocketChannelPtr&, const std::string&)> onopen;
     std::function<void(const WebSocketChannelPtr&, const std::string&)> onmessage;
     std::function<void(const WebSocketChannelPtr&)>                     onclose;
+    // Streaming mode: if set, text/binary payload is delivered as it arrives
+    // instead of onmessage, fin is true on the last piece of a message.
+    // NOTE: compressed messages are inflated and delivered at once.
+    std::function<void(const WebSocketChannelPtr&, const char* data, size_t size, bool fin)> onfragment;
     int ping_interval;
+    // close with 1009 if a message is longer than this, 0 means unlimited
+    size_t max_message_size;
+    // permessage-deflate, compiled WITH_ZLIB only
+    bool permessage_deflate;
+    WebSocketDeflateOptions deflate_options;
 
     WebSocketService() {
         ping_interval = 10000; // ms
+        max_message_size = 0;
+        permessage_deflate = false;
     }
+
+    // Encodes msg into one server frame shared by all channels,
+    // channels of other loops are sent by one post per loop.
+    // NOTE: thread-safe, closed channels are skipped.
+    // @retval number of channels
+    static int broadcast(const std::vector<WebSocketChannelPtr>& channels,
+                         const char* buf, int len, enum ws_opcode opcode = WS_OPCODE_BINARY);
+    static int broadcast(const std::vector<WebSocketChannelPtr>& channels,
+                         const std::string& msg, enum ws_opcode opcode = WS_OPCODE_TEXT) {
+        return broadcast(channels, msg.c_str(), msg.size(), opcode);
+    }
+    static int broadcast(const std::vector<WebSocketChannelPtr>& channels, const BufferPtr& frame);
 };
 
 class WebSocketServer : public HttpServer {
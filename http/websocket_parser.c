@@ -2,6 +2,14 @@
 #include <assert.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifdef assert
 # define assertFalse(msg) assert(0 && msg)
 #else
@@ -65,6 +73,9 @@ size_t websocket_parser_execute(websocket_parser *parser, const websocket_parser
                 if(CC & (1<<7)) {
                     parser->flags |= WS_FIN;
                 }
+                if(CC & (1<<6)) {
+                    parser->flags |= WS_RSV1;
+                }
                 SET_STATE(s_head);
 
                 frame_offset++;
@@ -171,21 +182,59 @@ size_t websocket_parser_execute(websocket_parser *parser, const websocket_parser
 }
 
 void websocket_parser_decode(char * dst, const char * src, size_t len, websocket_parser * parser) {
-    size_t i = 0;
-    for(; i < len; i++) {
-        dst[i] = src[i] ^ parser->mask[(i + parser->mask_offset) % 4];
-    }
-
-    parser->mask_offset = (uint8_t) ((i + parser->mask_offset) % 4);
+    parser->mask_offset = websocket_decode(dst, src, len, parser->mask, parser->mask_offset);
 }
 
 uint8_t websocket_decode(char * dst, const char * src, size_t len, const char mask[4], uint8_t mask_offset) {
     size_t i = 0;
+    // mask rotated by mask_offset, so that key[i % 4] applies to dst[i]
+    char key[4];
+    uint32_t key32;
+    for(i = 0; i < 4; i++) {
+        key[i] = mask[(i + mask_offset) % 4];
+    }
+    memcpy(&key32, key, 4);
+    i = 0;
+#if defined(__AVX2__)
+    {
+        __m256i k = _mm256_set1_epi32((int)key32);
+        for(; i + 32 <= len; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, k));
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        __m128i k = _mm_set1_epi32((int)key32);
+        for(; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, k));
+        }
+    }
+#elif defined(__ARM_NEON)
+    {
+        uint8x16_t k = vreinterpretq_u8_u32(vdupq_n_u32(key32));
+        for(; i + 16 <= len; i += 16) {
+            uint8x16_t v = vld1q_u8((const uint8_t*)(src + i));
+            vst1q_u8((uint8_t*)(dst + i), veorq_u8(v, k));
+        }
+    }
+#endif
+    {
+        uint64_t k = ((uint64_t)key32 << 32) | key32;
+        uint64_t v;
+        for(; i + 8 <= len; i += 8) {
+            memcpy(&v, src + i, 8);
+            v ^= k;
+            memcpy(dst + i, &v, 8);
+        }
+    }
     for(; i < len; i++) {
-        dst[i] = src[i] ^ mask[(i + mask_offset) % 4];
+        dst[i] = src[i] ^ key[i % 4];
     }
 
-    return (uint8_t) ((i + mask_offset) % 4);
+    return (uint8_t) ((len + mask_offset) % 4);
 }
 
 size_t websocket_calc_frame_size(websocket_flags flags, size_t data_len) {
@@ -204,13 +253,16 @@ size_t websocket_calc_frame_size(websocket_flags flags, size_t data_len) {
     return size;
 }
 
-size_t websocket_build_frame(char * frame, websocket_flags flags, const char mask[4], const char * data, size_t data_len) {
+size_t websocket_build_frame_header(char * frame, websocket_flags flags, const char mask[4], size_t data_len) {
     size_t body_offset = 0;
     frame[0] = 0;
     frame[1] = 0;
     if(flags & WS_FIN) {
         frame[0] = (char) (1 << 7);
     }
+    if(flags & WS_RSV1) {
+        frame[0] |= (char) (1 << 6);
+    }
     frame[0] |= flags & WS_OP_MASK;
     if(flags & WS_HAS_MASK) {
         frame[1] = (char) (1 << 7);
@@ -239,8 +291,16 @@ size_t websocket_build_frame(char * frame, websocket_flags flags, const char mas
         if(mask != NULL) {
             memcpy(&frame[body_offset], mask, 4);
         }
-        websocket_decode(&frame[body_offset + 4], data, data_len, &frame[body_offset], 0);
         body_offset += 4;
+    }
+
+    return body_offset;
+}
+
+size_t websocket_build_frame(char * frame, websocket_flags flags, const char mask[4], const char * data, size_t data_len) {
+    size_t body_offset = websocket_build_frame_header(frame, flags, mask, data_len);
+    if(flags & WS_HAS_MASK) {
+        websocket_encode(&frame[body_offset], data, data_len, &frame[body_offset - 4], 0);
     } else {
         memcpy(&frame[body_offset], data, data_len);
     }
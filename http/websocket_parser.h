@@ -39,6 +39,8 @@ typedef enum websocket_flags {
     // marks
     WS_FINAL_FRAME = 0x10,
     WS_HAS_MASK    = 0x20,
+    // permessage-deflate: compressed message
+    WS_RSV1        = 0x40,
 } websocket_flags;
 
 #define WS_OP_MASK 0xF
@@ -86,6 +88,9 @@ uint8_t websocket_decode(char * dst, const char * src, size_t len, const char ma
 // Calculate frame size using flags and data length
 size_t websocket_calc_frame_size(websocket_flags flags, size_t data_len);
 
+// Create frame header, including mask, @return header size <= 14
+size_t websocket_build_frame_header(char * frame, websocket_flags flags, const char mask[4], size_t data_len);
+
 // Create string representation of frame
 size_t websocket_build_frame(char * frame, websocket_flags flags, const char mask[4], const char * data, size_t data_len);
 
@@ -44,3 +44,18 @@ int ws_build_frame(
     if (has_mask) flags |=  WS_HAS_MASK;
     return websocket_build_frame(out, (websocket_flags)flags, mask, data, data_len);
 }
+
+int ws_build_frame_header(
+    char out[WS_MAX_FRAME_HEADER_SIZE],
+    int data_len,
+    const char mask[4],
+    bool has_mask,
+    enum ws_opcode opcode,
+    bool fin,
+    bool compressed) {
+    int flags = opcode;
+    if (fin) flags |= WS_FIN;
+    if (has_mask) flags |=  WS_HAS_MASK;
+    if (compressed) flags |= WS_RSV1;
+    return websocket_build_frame_header(out, (websocket_flags)flags, mask, data_len);
+}
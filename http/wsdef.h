@@ -9,6 +9,12 @@
 #define SEC_WEBSOCKET_VERSION   "Sec-WebSocket-Version"
 #define SEC_WEBSOCKET_KEY       "Sec-WebSocket-Key"
 #define SEC_WEBSOCKET_ACCEPT    "Sec-WebSocket-Accept"
+#define SEC_WEBSOCKET_EXTENSIONS "Sec-WebSocket-Extensions"
+
+// fix-header[2] + var-length[8] + mask[4]
+#define WS_MAX_FRAME_HEADER_SIZE    14
+// 1st byte: FIN RSV1 RSV2 RSV3 opcode[4]
+#define WS_FRAME_RSV1               0x40
 
 #define WS_SERVER_MIN_FRAME_SIZE    2
 // 1000 1001 0000 0000
@@ -22,6 +28,14 @@
 // 1000 1010 1000 0000
 #define WS_CLIENT_PONG_FRAME        "\212\200WSWS"
 
+// close status code
+enum ws_close_code {
+    WS_CLOSE_NORMAL             = 1000,
+    WS_CLOSE_PROTOCOL_ERROR     = 1002,
+    WS_CLOSE_INVALID_PAYLOAD    = 1007,
+    WS_CLOSE_MESSAGE_TOO_BIG    = 1009,
+};
+
 enum ws_session_type {
     WS_CLIENT,
     WS_SERVER,
@@ -53,6 +67,19 @@ HV_EXPORT int ws_build_frame(
     enum ws_opcode opcode DEFAULT(WS_OPCODE_TEXT),
     bool fin DEFAULT(true));
 
+// fix-header[2] + var-length[2/8] + mask[4], data not copied,
+// so that header and data can be sent by writev.
+// NOTE: data must be masked by caller if has_mask.
+// @param compressed: RSV1 of permessage-deflate
+HV_EXPORT int ws_build_frame_header(
+    char out[WS_MAX_FRAME_HEADER_SIZE],
+    int data_len,
+    const char mask[4],
+    bool has_mask DEFAULT(false),
+    enum ws_opcode opcode DEFAULT(WS_OPCODE_TEXT),
+    bool fin DEFAULT(true),
+    bool compressed DEFAULT(false));
+
 HV_INLINE int ws_client_build_frame(
     char* out,
     const char* data,
@@ -27,3 +27,5 @@ bin/socketpair_test
 # bin/threadpool_test
 # bin/objectpool_test
 bin/sizeof_test
+bin/hio_sizeof_test
+bin/splice_test
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stddef.h>
+
+#include "hevent.h"
+
+// NOTE: guard the layout of struct hio_s, one per connection.
+// sizeof(sockaddr_u) is 28 on x64 without ENABLE_UDS.
+#define HIO_SIZE_MAX    (264 + 2 * sizeof(sockaddr_u))
+#define CACHE_LINE_SIZE 64
+
+#define PRINT_OFFSET(field) \
+    printf("offsetof(struct hio_s, %s)=%lu\n", #field, (unsigned long)offsetof(struct hio_s, field))
+
+// NOTE: checked at compile time, assert is gone with NDEBUG.
+#define STATIC_ASSERT_CAT(a, b) a##b
+#define STATIC_ASSERT_LINE(cond, line) \
+    typedef char STATIC_ASSERT_CAT(static_assert_line_, line)[(cond) ? 1 : -1]
+#define STATIC_ASSERT(cond) STATIC_ASSERT_LINE(cond, __LINE__)
+
+#define ASSERT_IN_CACHE_LINE(field, line) \
+    STATIC_ASSERT(offsetof(struct hio_s, field) >= (line) * CACHE_LINE_SIZE && \
+                  offsetof(struct hio_s, field) + sizeof(((struct hio_s*)0)->field) <= ((line) + 1) * CACHE_LINE_SIZE)
+
+STATIC_ASSERT(sizeof(struct hio_s) <= HIO_SIZE_MAX);
+
+// hevent fields used by pending events
+ASSERT_IN_CACHE_LINE(cb, 0);
+ASSERT_IN_CACHE_LINE(pending_next, 0);
+// fields used by every read
+ASSERT_IN_CACHE_LINE(fd, 1);
+ASSERT_IN_CACHE_LINE(events, 1);
+ASSERT_IN_CACHE_LINE(revents, 1);
+ASSERT_IN_CACHE_LINE(io_type, 1);
+ASSERT_IN_CACHE_LINE(readbuf, 1);
+ASSERT_IN_CACHE_LINE(read_until, 1);
+ASSERT_IN_CACHE_LINE(read_cb, 1);
+// fields used by every write
+ASSERT_IN_CACHE_LINE(write_cb, 1);
+ASSERT_IN_CACHE_LINE(write_queue, 2);
+ASSERT_IN_CACHE_LINE(write_queue_bytes, 2);
+ASSERT_IN_CACHE_LINE(keepalive_timer, 2);
+ASSERT_IN_CACHE_LINE(ctx, 2);
+ASSERT_IN_CACHE_LINE(ext, 2);
+
+int main() {
+    printf("sizeof(struct hevent_s)=%lu\n", (unsigned long)sizeof(struct hevent_s));
+    printf("sizeof(struct hio_s)=%lu\n", (unsigned long)sizeof(struct hio_s));
+    printf("sizeof(struct hio_ext_s)=%lu\n", (unsigned long)sizeof(struct hio_ext_s));
+    PRINT_OFFSET(fd);
+    PRINT_OFFSET(readbuf);
+    PRINT_OFFSET(read_cb);
+    PRINT_OFFSET(write_queue);
+    PRINT_OFFSET(keepalive_timer);
+    PRINT_OFFSET(ext);
+    PRINT_OFFSET(localaddr);
+
+    printf("hio_sizeof_test OK!\n");
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * splice_test.c
+ *
+ * half-close through a spliced tcp upstream:
+ * client => proxy(hio_setup_tcp_upstream) => backend,
+ * client sends a request and shutdown(SHUT_WR),
+ * the whole response must come back before EOF.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hloop.h"
+#include "hsocket.h"
+#include "hthread.h"
+#include "htime.h"
+
+#define BACKEND_PORT    20491
+#define PROXY_PORT      20492
+#define REQUEST_SIZE    (64 * 1024)
+// larger than a pipe and socket buffers
+#define RESPONSE_SIZE   (8 * 1024 * 1024)
+
+static hloop_t* loop = NULL;
+// 0: respond after EOF of request, 1: respond before reading request
+static int respond_first = 0;
+static int failed = 0;
+
+static void fill(char* buf, int len) {
+    for (int i = 0; i < len; ++i) {
+        buf[i] = (char)(i % 251);
+    }
+}
+
+static int recv_all(int fd, char* buf, int len) {
+    int total = 0;
+    while (1) {
+        int nrecv = recv(fd, buf + total, len - total, 0);
+        if (nrecv <= 0) break;
+        total += nrecv;
+        if (total == len) {
+            // expect EOF
+            char c;
+            if (recv(fd, &c, 1, 0) > 0) return -1;
+            break;
+        }
+    }
+    return total;
+}
+
+static int send_all(int fd, const char* buf, int len) {
+    int total = 0;
+    while (total < len) {
+        int nsend = send(fd, buf + total, len - total, 0);
+        if (nsend <= 0) break;
+        total += nsend;
+    }
+    return total;
+}
+
+static HTHREAD_ROUTINE(backend_thread) {
+    int listenfd = (int)(intptr_t)userdata;
+    char* request = (char*)malloc(REQUEST_SIZE);
+    char* response = (char*)malloc(RESPONSE_SIZE);
+    fill(response, RESPONSE_SIZE);
+    for (int round = 0; round < 2; ++round) {
+        int connfd = accept(listenfd, NULL, NULL);
+        if (connfd < 0) break;
+        if (respond_first) {
+            send_all(connfd, response, RESPONSE_SIZE);
+        }
+        // NOTE: EOF of request means half-close passed on by proxy
+        int nrecv = recv_all(connfd, request, REQUEST_SIZE);
+        if (nrecv != REQUEST_SIZE) {
+            printf("backend recv %d != %d\n", nrecv, REQUEST_SIZE);
+            failed = 1;
+        }
+        if (!respond_first) {
+            send_all(connfd, response, RESPONSE_SIZE);
+        }
+        closesocket(connfd);
+    }
+    free(request);
+    free(response);
+    return 0;
+}
+
+static HTHREAD_ROUTINE(client_thread) {
+    char* request = (char*)malloc(REQUEST_SIZE);
+    char* response = (char*)malloc(RESPONSE_SIZE);
+    char* expected = (char*)malloc(RESPONSE_SIZE);
+    fill(request, REQUEST_SIZE);
+    fill(expected, RESPONSE_SIZE);
+    for (int round = 0; round < 2; ++round) {
+        respond_first = round;
+        int connfd = ConnectTimeout("127.0.0.1", PROXY_PORT, 3000);
+        if (connfd < 0) {
+            printf("connect proxy failed\n");
+            failed = 1;
+            break;
+        }
+        send_all(connfd, request, REQUEST_SIZE);
+        shutdown(connfd, SHUT_WR);
+        if (respond_first) {
+            // NOTE: EOF reaches proxy while response is waiting in the pipe
+            hv_msleep(200);
+        }
+        memset(response, 0, RESPONSE_SIZE);
+        int nrecv = recv_all(connfd, response, RESPONSE_SIZE);
+        if (nrecv != RESPONSE_SIZE || memcmp(response, expected, RESPONSE_SIZE) != 0) {
+            printf("round %d: client recv %d != %d\n", round, nrecv, RESPONSE_SIZE);
+            failed = 1;
+        } else {
+            printf("round %d: client recv %d ok\n", round, nrecv);
+        }
+        closesocket(connfd);
+    }
+    free(request);
+    free(response);
+    free(expected);
+    hloop_stop(loop);
+    return 0;
+}
+
+static void on_accept(hio_t* io) {
+    hio_t* upstream_io = hio_setup_tcp_upstream(io, "127.0.0.1", BACKEND_PORT, 0);
+    if (upstream_io == NULL) {
+        hio_close(io);
+    }
+}
+
+int main(int argc, char* argv[]) {
+#ifdef OS_LINUX
+    int listenfd = Listen(BACKEND_PORT, "127.0.0.1");
+    if (listenfd < 0) {
+        return -10;
+    }
+    loop = hloop_new(0);
+    hio_t* listenio = hloop_create_tcp_server(loop, "127.0.0.1", PROXY_PORT, on_accept);
+    if (listenio == NULL) {
+        return -20;
+    }
+    hthread_t backend = hthread_create(backend_thread, (void*)(intptr_t)listenfd);
+    hthread_t client = hthread_create(client_thread, NULL);
+    hloop_run(loop);
+    hthread_join(client);
+    closesocket(listenfd);
+    hthread_join(backend);
+    hloop_free(&loop);
+    printf("splice_test %s\n", failed ? "failed" : "ok");
+    return failed;
+#else
+    // NOTE: splice on linux only
+    return 0;
+#endif
+}